@@ -1,9 +1,41 @@
+#include "MemoryManager/InstanceFinder.hpp"
 #include "MemoryManager/LinuxMemoryManager.hpp"
+#include "MemoryManager/PageHash.hpp"
+#include "MemoryManager/PatchManager.hpp"
+#include "MemoryManager/RegionTraversal.hpp"
+#include "MemoryManager/SnapshotMemoryManager.hpp"
+#include "MemoryManager/StringSearch.hpp"
+#include "MemoryManager/WatchList.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <memory>
 #include <print>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+struct Polymorphic {
+	int tag;
+
+	explicit Polymorphic(int tag)
+		: tag(tag)
+	{
+	}
+	virtual ~Polymorphic() = default;
+};
 
 int main()
 {
@@ -57,7 +89,329 @@ int main()
 		s += static_cast<uint8_t>(b);
 	assert(s == 123);
 
+	MemoryManager::WatchList watch_list{ memory_manager };
+	// Removes itself on the first change, regrouping mustn't invalidate the changes that are still being dispatched
+	MemoryManager::WatchList<decltype(memory_manager)>::WatchId one_shot = 0;
+	one_shot = watch_list.add<int>(my_integer, [&](const auto&) {
+		watch_list.remove(one_shot);
+		[[maybe_unused]] const std::size_t group_count = watch_list.get_group_count();
+	});
+	int changes = 0;
+	watch_list.add<int>(my_integer, [&changes](const auto& change) {
+		int new_value = 0;
+		std::memcpy(&new_value, change.current.data(), sizeof(int));
+		assert(new_value == 456);
+		changes++;
+	});
+
+	const bool first_poll_empty = watch_list.poll().empty(); // The first poll only records the initial values
+	assert(first_poll_empty);
+	val = 456;
+	memory_manager.write(my_integer, &val, sizeof(int));
+	const auto& polled_changes = watch_list.poll();
+	assert(polled_changes.size() == 2);
+	int polled_value = 0;
+	std::memcpy(&polled_value, polled_changes.back().current.data(), sizeof(int));
+	assert(polled_value == 456);
+	const bool last_poll_empty = watch_list.poll().empty();
+	assert(last_poll_empty);
+	assert(changes == 1 && watch_list.size() == 1);
+
 	memory_manager.deallocate(my_integer, sizeof(int));
 
+	const std::size_t page_size = memory_manager.get_page_granularity();
+	std::vector<std::unique_ptr<Polymorphic>> polymorphic_objects;
+	for (int i = 99; i < 109; i++)
+		polymorphic_objects.push_back(std::make_unique<Polymorphic>(i));
+	const auto heap_object = std::make_unique<int>(4242);
+	const std::string heap_text = "Strings on the main heap are found too";
+	std::uintptr_t snapshot_pages = memory_manager.allocate(page_size * 3, "rw-");
+	val = 789;
+	memory_manager.write(snapshot_pages + page_size * 2, &val, sizeof(int));
+	const std::uintptr_t vanishing_page = memory_manager.allocate(page_size, "r--");
+	memory_manager.sync_layout();
+	// The layout still contains the page, so the snapshot fails to capture it
+	memory_manager.deallocate(vanishing_page, page_size);
+
+	const auto snapshot_path = std::filesystem::temp_directory_path() / "MemoryManagerExample.snapshot";
+	MemoryManager::write_snapshot(memory_manager, snapshot_path);
+	{
+		MemoryManager::SnapshotMemoryManager snapshot{ snapshot_path };
+		assert(snapshot.get_layout().size() == memory_manager.get_layout().size());
+
+		const auto* snapshot_region = snapshot.get_layout().find_region(snapshot_pages);
+		assert(snapshot_region != nullptr && snapshot_region->is_captured());
+		// The first two pages are all zeros and have been omitted from the file
+		assert(snapshot_region->view()[snapshot_pages - snapshot_region->get_address()] == std::byte{});
+
+		val = -1;
+		snapshot.read(snapshot_pages + page_size * 2, &val, sizeof(int));
+		assert(val == 789);
+
+		// The main heap is captured as well
+		val = -1;
+		snapshot.read(reinterpret_cast<std::uintptr_t>(heap_object.get()), &val, sizeof(int));
+		assert(val == 4242);
+
+		// Uncaptured regions aren't readable, scanners skip them instead of failing to read them
+		const auto* vanished_region = snapshot.get_layout().find_region(vanishing_page);
+		assert(vanished_region != nullptr && !vanished_region->is_captured() && !vanished_region->get_flags().is_readable());
+		const auto snapshot_strings = MemoryManager::extract_strings(snapshot);
+		assert(std::ranges::any_of(snapshot_strings, [&](const auto& string) { return string.address == reinterpret_cast<std::uintptr_t>(heap_text.data()) && string.text == heap_text; }));
+	}
+	std::filesystem::remove(snapshot_path);
+
+	constexpr std::string_view ASCII_TEXT = "Hello, World";
+	constexpr std::u16string_view UTF16_TEXT = u"Wide World";
+	memory_manager.write(snapshot_pages, ASCII_TEXT.data(), ASCII_TEXT.size());
+	memory_manager.write(snapshot_pages + page_size, UTF16_TEXT.data(), UTF16_TEXT.size() * sizeof(char16_t));
+
+	const auto in_snapshot_pages = [snapshot_pages](const auto& reg) { return reg.get_address() <= snapshot_pages && reg.get_address() + reg.get_length() > snapshot_pages; };
+	const auto strings = MemoryManager::extract_strings(memory_manager, {}, { .filter = in_snapshot_pages });
+	assert(std::ranges::any_of(strings, [&](const auto& string) { return string.address == snapshot_pages && string.text == ASCII_TEXT; }));
+	assert(std::ranges::any_of(strings, [&](const auto& string) { return string.address == snapshot_pages + page_size && string.text == "Wide World"; }));
+
+	MemoryManager::NeedleSearcher searcher;
+	const std::size_t ascii_world = searcher.add_string("World");
+	const std::size_t wide_world = searcher.add_string("World", MemoryManager::StringEncoding::UTF16LE);
+	const auto matches = searcher.search(memory_manager, { .filter = in_snapshot_pages });
+	assert(std::ranges::any_of(matches, [&](const auto& match) { return match.needle == ascii_world && match.address == snapshot_pages + 7; }));
+	assert(std::ranges::any_of(matches, [&](const auto& match) { return match.needle == wide_world && match.address == snapshot_pages + page_size + 10; }));
+
+	// UTF-16 beyond ASCII has to be requested, the text is converted to UTF-8
+	constexpr std::u16string_view BMP_TEXT = u"Gr\u00F6\u00DFe \u65E5\u672C";
+	memory_manager.write(snapshot_pages + page_size + 64, BMP_TEXT.data(), BMP_TEXT.size() * sizeof(char16_t));
+	const auto bmp_strings = MemoryManager::extract_strings(memory_manager, { .encodings = MemoryManager::StringEncoding::UTF16LE, .utf16_beyond_ascii = true }, { .filter = in_snapshot_pages });
+	assert(std::ranges::any_of(bmp_strings, [&](const auto& string) { return string.address == snapshot_pages + page_size + 64 && string.text == "Gr\u00F6\u00DFe \u65E5\u672C"; }));
+
+	// Needles may contain control characters
+	const std::size_t control_needle = searcher.add_string("\u0085", MemoryManager::StringEncoding::UTF16LE);
+	assert(searcher.get_needle(control_needle).size() == 2 && searcher.get_needle(control_needle).front() == std::byte{ 0x85 });
+
+	const auto heap_strings = MemoryManager::extract_strings(memory_manager, {}, { .name_filter = [](const auto& name) { return name == "[heap]"; } });
+	assert(std::ranges::any_of(heap_strings, [&](const auto& string) { return string.address == reinterpret_cast<std::uintptr_t>(heap_text.data()) && string.text == heap_text; }));
+
+	// Runs that cross chunk borders are stitched back together
+	const std::string long_text(page_size * 2 + 100, 'A');
+	memory_manager.write(snapshot_pages + 100, long_text.data(), long_text.size());
+	const auto chunked_strings = MemoryManager::extract_strings(memory_manager, {}, { .chunk_size = page_size, .filter = in_snapshot_pages });
+	assert(std::ranges::count_if(chunked_strings, [&](const auto& string) { return string.address == snapshot_pages + 100 && string.text == long_text; }) == 1);
+	assert(std::ranges::none_of(chunked_strings, [&](const auto& string) { return string.address > snapshot_pages + 100 && string.address < snapshot_pages + 100 + long_text.size(); }));
+
+	// Fake an object with a vtable pointer and a distinctive field
+	static constexpr int FAKE_VTABLE = 0;
+	const std::uintptr_t fake_object = snapshot_pages + page_size * 2 + 64;
+	const std::array<std::uintptr_t, 2> object_words{ reinterpret_cast<std::uintptr_t>(&FAKE_VTABLE), 0xC0FFEE };
+	memory_manager.write(fake_object, object_words.data(), sizeof(object_words));
+
+	MemoryManager::InstanceFinder finder{ memory_manager, reinterpret_cast<std::uintptr_t>(&FAKE_VTABLE) };
+	finder.where_field<std::uintptr_t>(sizeof(std::uintptr_t), [](std::uintptr_t field) { return field == 0xC0FFEE; });
+	const auto instances = finder.find();
+	assert(instances.size() == 1 && instances.front() == fake_object);
+
+	// Incremental finders only scan pages that have been written since their last run (if the kernel tracks soft-dirty bits)
+	finder.set_incremental(true);
+	const std::size_t initial_instances = finder.find().size();
+	assert(initial_instances == 1);
+	const std::uintptr_t second_fake_object = fake_object + sizeof(object_words);
+	memory_manager.write(second_fake_object, object_words.data(), sizeof(object_words));
+	const std::size_t added_instances = finder.find().size();
+	assert(added_instances == 2);
+	const std::array<std::uintptr_t, 2> cleared_words{};
+	memory_manager.write(second_fake_object, cleared_words.data(), sizeof(cleared_words));
+	const std::size_t remaining_instances = finder.find().size();
+	assert(remaining_instances == 1);
+
+	// Real objects live on the heap, the finder may also be configured as a temporary
+	const Polymorphic& first_object = *polymorphic_objects.front();
+	std::uintptr_t polymorphic_vtable = 0;
+	std::memcpy(&polymorphic_vtable, &first_object, sizeof(std::uintptr_t));
+	const std::size_t tag_offset = reinterpret_cast<std::uintptr_t>(&first_object.tag) - reinterpret_cast<std::uintptr_t>(&first_object);
+	const auto polymorphic_finder = MemoryManager::InstanceFinder{ memory_manager, polymorphic_vtable }
+										.where_field<int>(tag_offset, [](int tag) { return tag >= 100; });
+	const auto polymorphic_instances = polymorphic_finder.find();
+	assert(polymorphic_instances.size() == polymorphic_objects.size() - 1);
+	for (const auto& object : polymorphic_objects | std::views::drop(1))
+		assert(std::ranges::binary_search(polymorphic_instances, reinterpret_cast<std::uintptr_t>(object.get())));
+
+	// The position of every stripe contributes to the hash
+	std::array<std::byte, 4096> page_bytes{};
+	for (std::size_t i = 0; i < page_bytes.size(); i++)
+		page_bytes[i] = static_cast<std::byte>(i / 64);
+	const std::uint64_t page_hash = MemoryManager::hash_page(page_bytes);
+	std::swap_ranges(page_bytes.begin(), page_bytes.begin() + 64, page_bytes.begin() + 64);
+	assert(MemoryManager::hash_page(page_bytes) != page_hash);
+
+	MemoryManager::PageHasher hasher{ memory_manager, in_snapshot_pages };
+	const std::size_t added_regions = hasher.rehash().added_regions.size();
+	assert(added_regions == 1);
+	val = 1337;
+	memory_manager.write(snapshot_pages + page_size, &val, sizeof(int));
+	const auto difference = hasher.rehash();
+	assert(difference.changed_pages.size() == 1 && difference.changed_pages.front() == snapshot_pages + page_size);
+
+	// Every page is visited exactly once, each chunk also sees the beginning of the next one
+	{
+		const MemoryManager::RegionTraversal traversal{ memory_manager, { .chunk_size = page_size, .overlap = 16, .thread_count = 2, .filter = in_snapshot_pages } };
+		const auto* traversed_region = memory_manager.get_layout().find_region(snapshot_pages);
+		std::atomic_size_t covered = 0;
+		const bool completed = traversal.run([&](std::uintptr_t address, std::span<const std::byte> chunk) {
+			assert((address - traversed_region->get_address()) % page_size == 0 && chunk.size() <= page_size + 16);
+			covered += std::min(chunk.size(), traversal.get_chunk_size());
+		});
+		assert(completed && covered == traversed_region->get_length());
+
+		std::atomic_size_t visited = 0;
+		const bool exited_early = !traversal.run([&](std::uintptr_t, std::span<const std::byte>) {
+			visited++;
+			return false;
+		});
+		assert(exited_early && visited <= 2);
+	}
+
+	// Regions that can't be read are skipped and reported, the others are still traversed
+	{
+		MemoryManager::LinuxMemoryManager<true, false, false> reading_manager{ getpid() };
+		const std::uintptr_t vanishing_pages = memory_manager.allocate(page_size * 2, "r--");
+		reading_manager.sync_layout();
+		memory_manager.deallocate(vanishing_pages, page_size * 2);
+
+		std::vector<std::uintptr_t> failed_chunks;
+		const MemoryManager::RegionTraversal traversal{ reading_manager, {
+			.chunk_size = page_size,
+			.thread_count = 1,
+			.filter = [&](const auto& region) { return in_snapshot_pages(region) || region.get_address() == vanishing_pages; },
+			.on_read_failure = [&](const auto&, std::uintptr_t address, std::exception_ptr) { failed_chunks.push_back(address); },
+		} };
+		std::atomic_size_t traversed = 0;
+		const bool completed = traversal.run([&](std::uintptr_t, std::span<const std::byte> chunk) { traversed += chunk.size(); });
+		assert(completed && traversed == reading_manager.get_layout().find_region(snapshot_pages)->get_length());
+		assert(failed_chunks.size() == 1 && failed_chunks.front() == vanishing_pages);
+	}
+
+	// Our own code hasn't been patched, so it should match the executable on disk
+	const auto* code_region = memory_manager.get_layout().find_region(reinterpret_cast<std::uintptr_t>(+[] { }));
+	assert(code_region != nullptr && code_region->get_flags().is_executable());
+	const auto modified_pages = MemoryManager::find_modified_pages(*code_region);
+	assert(modified_pages.empty());
+
+	memory_manager.deallocate(snapshot_pages, page_size * 3);
+
+	// Without forced writes, patching read-only memory requires changing the protection
+	MemoryManager::LinuxMemoryManager<false, false, true> protecting_manager;
+	const std::uintptr_t read_only_pages = protecting_manager.allocate(page_size * 2, "r--");
+	protecting_manager.sync_layout();
+	{
+		MemoryManager::PatchManager patch_manager{ protecting_manager };
+		const std::array<std::byte, 2> patch_bytes{ std::byte{ 0x13 }, std::byte{ 0x37 } };
+		// Crosses the page boundary, both pages are unprotected as one range
+		patch_manager.add(read_only_pages + page_size - 1, patch_bytes);
+		patch_manager.add(read_only_pages, patch_bytes);
+
+		patch_manager.set_enabled(true);
+		const auto* read_only = reinterpret_cast<const std::byte*>(read_only_pages);
+		assert(read_only[0] == std::byte{ 0x13 } && read_only[page_size] == std::byte{ 0x37 });
+
+		protecting_manager.sync_layout();
+		assert(!protecting_manager.get_layout().find_region(read_only_pages)->get_flags().is_writeable());
+
+		patch_manager.toggle();
+		assert(read_only[0] == std::byte{} && read_only[page_size] == std::byte{});
+	}
+	protecting_manager.deallocate(read_only_pages, page_size * 2);
+
+	// Reading the original bytes of inaccessible memory requires changing the protection too
+	const std::uintptr_t inaccessible_page = protecting_manager.allocate(page_size, "---");
+	protecting_manager.sync_layout();
+	{
+		MemoryManager::PatchManager patch_manager{ protecting_manager };
+		const std::array<std::byte, 1> patch_bytes{ std::byte{ 0x42 } };
+		patch_manager.add(inaccessible_page, patch_bytes);
+		patch_manager.set_enabled(true);
+		protecting_manager.protect(inaccessible_page, page_size, "r--");
+		assert(*reinterpret_cast<const std::byte*>(inaccessible_page) == std::byte{ 0x42 });
+	}
+	protecting_manager.deallocate(inaccessible_page, page_size);
+
+	// A batch that fails halfway can still be reverted
+	{
+		const std::uintptr_t patched_page = memory_manager.allocate(page_size, "rw-");
+		const std::uintptr_t vanishing_page = memory_manager.allocate(page_size, "r--");
+		MemoryManager::PatchManager patch_manager{ memory_manager };
+		const std::array<std::byte, 1> patch_bytes{ std::byte{ 0x42 } };
+		patch_manager.add(patched_page, patch_bytes);
+		patch_manager.add(vanishing_page, patch_bytes);
+		memory_manager.deallocate(vanishing_page, page_size);
+
+		bool failed = false;
+		try {
+			patch_manager.set_enabled(true);
+		} catch (const std::exception&) {
+			failed = true;
+		}
+		assert(failed && !patch_manager.is_enabled());
+		assert(*reinterpret_cast<const std::byte*>(patched_page) == std::byte{ 0x42 });
+		patch_manager.set_enabled(false);
+		assert(*reinterpret_cast<const std::byte*>(patched_page) == std::byte{});
+		memory_manager.deallocate(patched_page, page_size);
+	}
+
+	// Only the touched page of a fresh mapping is backed by memory
+	const std::uintptr_t sparse_pages = memory_manager.allocate(page_size * 4, "rw-");
+	val = 42;
+	memory_manager.write(sparse_pages + page_size * 2, &val, sizeof(int));
+	memory_manager.sync_layout();
+	{
+		const auto* sparse_region = memory_manager.get_layout().find_region(sparse_pages);
+		const auto presence = memory_manager.query_page_presence(sparse_pages, page_size * 4, MemoryManager::LinuxResidencyPolicy::PRESENT);
+		assert(presence.get_present_count() == 1 && presence.is_present(2));
+
+		const std::uintptr_t touched = sparse_pages + page_size * 2;
+		bool found = false;
+		sparse_region->for_each_resident_span([&](std::uintptr_t address, std::span<const std::byte> span) {
+			assert(address + span.size() <= sparse_pages || address >= touched);
+			if (address <= touched && address + span.size() > touched)
+				found = span[touched - address] == std::byte{ 42 };
+		});
+		assert(found);
+
+		// Traversals can skip them as well, the mapping may have been merged with its neighbours
+		const MemoryManager::RegionTraversal traversal{ memory_manager, {
+			.thread_count = 1,
+			.filter = [&](const auto& region) { return &region == sparse_region; },
+			.skip_absent_pages = true,
+		} };
+		bool visited_touched = false;
+		traversal.run([&](std::uintptr_t address, std::span<const std::byte> chunk) {
+			assert(address + chunk.size() <= sparse_pages || address >= sparse_pages + page_size * 4 || (address == touched && chunk.size() == page_size));
+			visited_touched |= address == touched;
+		});
+		assert(visited_touched);
+	}
+	memory_manager.deallocate(sparse_pages, page_size * 4);
+
+	// Pages of a mapped file hold its contents even before they are faulted in
+	const auto file_path = std::filesystem::temp_directory_path() / "MemoryManagerExample.pages";
+	{
+		std::ofstream file{ file_path, std::ios::binary };
+		const std::string contents(page_size * 8, 'Z');
+		file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+	}
+	{
+		const int file_descriptor = open(file_path.c_str(), O_RDONLY);
+		void* file_pages = mmap(nullptr, page_size * 8, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+		close(file_descriptor);
+		assert(file_pages != MAP_FAILED);
+		memory_manager.sync_layout();
+
+		std::size_t file_bytes = 0;
+		memory_manager.get_layout().find_region(reinterpret_cast<std::uintptr_t>(file_pages))->for_each_resident_span([&](std::uintptr_t, std::span<const std::byte> span) {
+			file_bytes += std::ranges::count(span, std::byte{ 'Z' });
+		});
+		assert(file_bytes == page_size * 8);
+		munmap(file_pages, page_size * 8);
+	}
+	std::filesystem::remove(file_path);
+
 	return 0;
 }
@@ -0,0 +1,315 @@
+#ifndef MEMORYMANAGER_INSTANCEFINDER_HPP
+#define MEMORYMANAGER_INSTANCEFINDER_HPP
+
+#include "MemoryManager/MemoryManager.hpp"
+#include "MemoryManager/RegionTraversal.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace MemoryManager {
+	/**
+	 * Finds objects by the value of their first word, usually the address of their vtable.
+	 *
+	 * Only readable, writable, private and anonymous regions are searched, which is where heap objects live.
+	 * Candidates can be filtered further by a chain of predicates, which are evaluated in the order they were added.
+	 * Finders can remember the candidates between runs and only scan pages that have been written since, see set_incremental.
+	 */
+	template <typename MemMgr>
+		requires Traversable<MemMgr>
+	class InstanceFinder {
+	public:
+		using RegionT = typename MemMgr::RegionT;
+
+		// object_bytes begins at the object and ends somewhere after it, at the latest at the end of its region
+		using Predicate = std::function<bool(std::uintptr_t object, std::span<const std::byte> object_bytes)>;
+
+	private:
+		const MemMgr* manager;
+		std::uintptr_t vtable;
+		std::vector<Predicate> predicates;
+
+		std::size_t alignment = alignof(std::uintptr_t);
+		std::size_t thread_count = 0;
+
+		struct CachedChunk {
+			std::size_t length;
+			std::vector<std::uintptr_t> candidates;
+		};
+
+		bool incremental = false;
+		// Candidates of the previous incremental run by chunk address, find() replaces them on every run
+		mutable std::unordered_map<std::uintptr_t, CachedChunk> cache;
+
+		[[nodiscard]] static bool is_heap(const RegionT& region)
+		{
+			if constexpr (FlagAware<RegionT>)
+				if (!region.get_flags().is_readable() || !region.get_flags().is_writeable())
+					return false;
+			if constexpr (SharedAware<RegionT>)
+				if (region.is_shared())
+					return false;
+			if constexpr (NameAware<RegionT>) {
+				// Mapped files, stacks and other special regions don't contain heap objects
+				const std::optional<std::string> name = region.get_name();
+				if (name.has_value() && *name != "[heap]" && !name->starts_with("[anon:"))
+					return false;
+			}
+			return true;
+		}
+
+		void scan(std::span<const std::byte> bytes, std::uintptr_t base, std::vector<std::uintptr_t>& hits) const
+		{
+			constexpr std::size_t WORD = sizeof(std::uintptr_t);
+			constexpr std::size_t WORDS_PER_BLOCK = 8;
+
+			std::size_t offset = (alignment - base % alignment) % alignment;
+
+			if (alignment == WORD) {
+				// Comparing a whole block before branching lets the compiler vectorize the comparisons
+				for (; offset + WORD * WORDS_PER_BLOCK <= bytes.size(); offset += WORD * WORDS_PER_BLOCK) {
+					std::array<std::uintptr_t, WORDS_PER_BLOCK> words{};
+					std::memcpy(words.data(), bytes.data() + offset, sizeof(words));
+
+					bool any = false;
+					for (const std::uintptr_t word : words)
+						any |= word == vtable;
+					if (!any)
+						continue;
+
+					for (std::size_t i = 0; i < WORDS_PER_BLOCK; i++)
+						if (words[i] == vtable)
+							hits.push_back(base + offset + i * WORD);
+				}
+			}
+
+			for (; offset + WORD <= bytes.size(); offset += alignment) {
+				std::uintptr_t word = 0;
+				std::memcpy(&word, bytes.data() + offset, WORD);
+				if (word == vtable)
+					hits.push_back(base + offset);
+			}
+		}
+
+		[[nodiscard]] bool matches(std::uintptr_t object, std::span<const std::byte> object_bytes) const
+		{
+			return std::ranges::all_of(predicates, [&](const Predicate& predicate) { return predicate(object, object_bytes); });
+		}
+
+		/**
+		 * Reuses the candidates of words on pages that haven't been written since the previous run and scans the others.
+		 * The dirty bits are queried and cleared before scanning, so writes during the scan are seen by the next run.
+		 */
+		template <typename Report>
+		void run_incremental(const RegionTraversal<MemMgr>& traversal, Report& report) const
+			requires DirtyTrackingAware<MemMgr> && GranularityAware<MemMgr>
+		{
+			constexpr std::size_t WORD = sizeof(std::uintptr_t);
+			const std::size_t chunk_size = traversal.get_chunk_size();
+			const std::size_t page_size = manager->get_page_granularity();
+
+			// A failing run leaves the cache empty, since the dirty bits have been cleared already
+			const auto previous_cache = std::exchange(cache, {});
+
+			using DirtyPages = decltype(manager->query_dirty_pages(0, 0));
+			std::vector<std::pair<std::uintptr_t, DirtyPages>> dirty_pages;
+			if (!previous_cache.empty())
+				for (const RegionT& region : manager->get_layout())
+					if (is_heap(region))
+						dirty_pages.emplace_back(region.get_address(), manager->query_dirty_pages(region.get_address(), region.get_length()));
+			manager->clear_dirty_pages();
+
+			std::unordered_map<std::uintptr_t, CachedChunk> next_cache;
+			std::mutex cache_mutex;
+			traversal.run([&](std::uintptr_t address, std::span<const std::byte> bytes) {
+				std::vector<std::uintptr_t> candidates;
+
+				const auto previous = previous_cache.find(address);
+				const auto region = std::ranges::upper_bound(dirty_pages, address, {}, &std::pair<std::uintptr_t, DirtyPages>::first);
+				if (previous == previous_cache.end() || previous->second.length != bytes.size() || region == dirty_pages.begin())
+					scan(bytes, address, candidates);
+				else {
+					const auto& [region_address, dirty] = *std::prev(region);
+					const std::size_t first_page = (address - region_address) / page_size;
+					auto is_dirty = [&](std::uintptr_t word) {
+						return dirty.is_present((word - region_address) / page_size) || dirty.is_present((word + WORD - 1 - region_address) / page_size);
+					};
+
+					// The word is checked again, in case the page was discarded without being written
+					for (const std::uintptr_t candidate : previous->second.candidates) {
+						std::uintptr_t word = 0;
+						std::memcpy(&word, bytes.data() + (candidate - address), WORD);
+						if (word == vtable && !is_dirty(candidate))
+							candidates.push_back(candidate);
+					}
+
+					// Words that touch a run of dirty pages are scanned again
+					const std::size_t page_count = (bytes.size() + page_size - 1) / page_size;
+					for (std::size_t page = 0; page < page_count;) {
+						if (!dirty.is_present(first_page + page)) {
+							page++;
+							continue;
+						}
+						std::size_t end = page + 1;
+						while (end < page_count && dirty.is_present(first_page + end))
+							end++;
+
+						const std::size_t scan_begin = page * page_size < WORD - 1 ? 0 : page * page_size - (WORD - 1);
+						const std::size_t scan_end = std::min(bytes.size(), end * page_size + WORD - 1);
+						scan(bytes.subspan(scan_begin, scan_end - scan_begin), address + scan_begin, candidates);
+						page = end;
+					}
+				}
+
+				// Words that begin in the overlap are found by the next chunk
+				std::erase_if(candidates, [&](std::uintptr_t candidate) { return candidate - address >= chunk_size; });
+				report(address, bytes, candidates);
+
+				const std::scoped_lock lock{ cache_mutex };
+				next_cache.emplace(address, CachedChunk{ .length = bytes.size(), .candidates = std::move(candidates) });
+			});
+
+			cache = std::move(next_cache);
+		}
+
+	public:
+		InstanceFinder(const MemMgr& manager, std::uintptr_t vtable)
+			: manager(&manager)
+			, vtable(vtable)
+		{
+		}
+
+		InstanceFinder& where(Predicate predicate)
+		{
+			predicates.push_back(std::move(predicate));
+			return *this;
+		}
+
+		/**
+		 * Adds a predicate on a field of the object.
+		 * Fields that extend past object_bytes are read through the memory manager if it is a Reader,
+		 * otherwise (or if that read fails) the object is rejected.
+		 */
+		template <typename T>
+			requires std::is_trivially_copyable_v<T>
+		InstanceFinder& where_field(std::size_t offset, std::function<bool(const T&)> predicate)
+		{
+			// The finder may be a temporary, the predicate must not refer to it
+			return where([manager = manager, offset, predicate = std::move(predicate)](std::uintptr_t object, std::span<const std::byte> object_bytes) {
+				T field;
+				if (offset + sizeof(T) <= object_bytes.size())
+					std::memcpy(&field, object_bytes.data() + offset, sizeof(T));
+				else if constexpr (Reader<MemMgr>) {
+					try {
+						manager->read(object + offset, &field, sizeof(T));
+					} catch (const std::exception&) {
+						return false;
+					}
+				} else
+					return false;
+				return predicate(field);
+			});
+		}
+
+		// Objects are expected to be aligned to this many bytes, defaults to the alignment of a pointer
+		InstanceFinder& set_alignment(std::size_t new_alignment)
+		{
+			if (new_alignment == 0)
+				throw std::invalid_argument{ "Alignment must not be zero" };
+			alignment = new_alignment;
+			return *this;
+		}
+
+		// 0 uses the hardware concurrency
+		InstanceFinder& set_thread_count(std::size_t new_thread_count) noexcept
+		{
+			thread_count = new_thread_count;
+			return *this;
+		}
+
+		/**
+		 * Incremental finders remember the candidates of every chunk and only scan the pages that have been written since
+		 * the previous find() again. The chunks are still read, since the predicates need the bytes of every candidate.
+		 * This is only supported on Linux kernels with soft-dirty bits, elsewhere every find() scans everything.
+		 * Every find() clears the soft-dirty bits of the entire target process, which interferes with anyone else tracking them.
+		 * Writes that happen during a find() may be missed by later runs, unless the target is stopped while searching.
+		 * An incremental finder must not be used by multiple threads at once.
+		 */
+		InstanceFinder& set_incremental(bool new_incremental)
+		{
+			incremental = new_incremental;
+			cache.clear();
+			return *this;
+		}
+
+		// Forgets the candidates of previous runs, so the next incremental find() scans everything
+		void reset() noexcept
+		{
+			cache.clear();
+		}
+
+		/**
+		 * @returns the addresses of all matching objects, sorted
+		 */
+		[[nodiscard]] std::vector<std::uintptr_t> find() const
+		{
+			const RegionTraversal<MemMgr> traversal{ *manager, {
+				// Words that straddle the end of a chunk are found in the overlap
+				.overlap = sizeof(std::uintptr_t) - 1,
+				.thread_count = thread_count,
+				.filter = is_heap,
+				// Pages that were never written can't contain objects
+				.skip_absent_pages = true,
+			} };
+			const std::size_t chunk_size = traversal.get_chunk_size();
+
+			std::vector<std::uintptr_t> results;
+			std::mutex results_mutex;
+			auto report = [&](std::uintptr_t address, std::span<const std::byte> bytes, const std::vector<std::uintptr_t>& candidates) {
+				std::vector<std::uintptr_t> objects;
+				for (const std::uintptr_t candidate : candidates)
+					if (matches(candidate, bytes.subspan(candidate - address)))
+						objects.push_back(candidate);
+
+				const std::scoped_lock lock{ results_mutex };
+				std::ranges::move(objects, std::back_inserter(results));
+			};
+
+			bool scanned = false;
+			if constexpr (DirtyTrackingAware<MemMgr> && GranularityAware<MemMgr>)
+				if (incremental && manager->supports_dirty_tracking()) {
+					run_incremental(traversal, report);
+					scanned = true;
+				}
+
+			if (!scanned)
+				traversal.run([&](std::uintptr_t address, std::span<const std::byte> bytes) {
+					std::vector<std::uintptr_t> candidates;
+					scan(bytes, address, candidates);
+					// Words that begin in the overlap are found by the next chunk
+					std::erase_if(candidates, [&](std::uintptr_t candidate) { return candidate - address >= chunk_size; });
+					report(address, bytes, candidates);
+				});
+
+			std::ranges::sort(results);
+			return results;
+		}
+	};
+}
+
+#endif
@@ -101,6 +101,12 @@ namespace MemoryManager {
 		{ reg.get_path() } -> std::same_as<std::optional<std::string>>;
 	};
 
+	template <typename Region>
+	concept OffsetAware = requires(const Region reg) {
+		// The offset into the file that is mapped by the region, only meaningful if the region has a path
+		{ reg.get_offset() } -> std::same_as<std::size_t>;
+	};
+
 	template <typename Region>
 	concept Viewable = requires(const Region reg, bool refresh) {
 		// Indicates if the view represents memory, that updates as it's changed.
@@ -116,6 +122,15 @@ namespace MemoryManager {
 		{ reg.view(refresh) } -> std::same_as<std::span<const std::byte>>;
 	};
 
+	template <typename Region>
+	concept PresenceAware = requires(const Region reg, std::size_t page) {
+		// Indicates if pages that aren't backed by memory are known to read as zeros, as in private anonymous memory
+		{ reg.is_private_anonymous() } -> std::convertible_to<bool>;
+
+		// One bit per page (at page granularity) of the region, set if the page is backed by memory
+		{ reg.get_page_presence().is_present(page) } -> std::convertible_to<bool>;
+	};
+
 	template <typename Region>
 		requires AddressAware<Region>
 	struct RegionComparator {
@@ -142,7 +157,9 @@ namespace MemoryManager {
 		SharedAware<Region> ||
 		NameAware<Region> ||
 		PathAware<Region> ||
-		Viewable<Region>;
+		OffsetAware<Region> ||
+		Viewable<Region> ||
+		PresenceAware<Region>;
 	// clang-format on
 
 	template <typename Region, typename Comparator = RegionComparator<Region>>
@@ -259,6 +276,23 @@ namespace MemoryManager {
 		 */
 		{ MemMgr::IS_LOCAL } -> std::convertible_to<bool>;
 	};
+
+	// Like LocalAware, this does not make a type a MemoryManager, it allows finding the pages that have been written recently
+	template <typename MemMgr>
+	concept DirtyTrackingAware = requires(const MemMgr manager, std::uintptr_t address, std::size_t length, std::size_t page) {
+		/**
+		 * Indicates if dirty pages can be tracked at all, otherwise no page is ever reported as dirty
+		 */
+		{ manager.supports_dirty_tracking() } -> std::convertible_to<bool>;
+
+		/**
+		 * Determines which pages of an address range have been written since the last call to clear_dirty_pages
+		 * @param address must be aligned to page granularity
+		 */
+		{ manager.query_dirty_pages(address, length).is_present(page) } -> std::convertible_to<bool>;
+
+		{ manager.clear_dirty_pages() };
+	};
 }
 
 #endif
@@ -0,0 +1,298 @@
+#ifndef MEMORYMANAGER_PAGEHASH_HPP
+#define MEMORYMANAGER_PAGEHASH_HPP
+
+#include "MemoryManager/MemoryManager.hpp"
+#include "MemoryManager/RegionTraversal.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace MemoryManager {
+	/**
+	 * Fast non-cryptographic hash, meant for detecting changes, not for resisting deliberate collisions.
+	 * The input is consumed in 64 byte stripes by eight independent lanes,
+	 * each of them only needs 32x32->64 bit multiplications, which vectorize with plain SSE2.
+	 * The key advances with every stripe like the secret offset of XXH3, so moving or swapping stripes changes the hash.
+	 */
+	[[nodiscard]] inline std::uint64_t hash_page(std::span<const std::byte> bytes) noexcept
+	{
+		constexpr std::size_t LANES = 8;
+		constexpr std::size_t STRIPE = LANES * sizeof(std::uint64_t);
+		static constexpr std::array<std::uint64_t, LANES> SECRET{
+			0xBE4BA423396CFEB8, 0x1CAD21F72C81017C, 0xDB979083E96DD4DE, 0x1F67B3B7A4A44072,
+			0x78E5C0CC4EE679CB, 0x2172FFCC7DD05A82, 0x8E2443F7744608B8, 0x4C263A81E69035E0
+		};
+		constexpr std::uint64_t PRIME = 0x9E3779B185EBCA87;
+
+		std::array<std::uint64_t, LANES> accumulators{ 1, 2, 3, 4, 5, 6, 7, 8 };
+		std::uint64_t stripe_key = 0;
+		std::size_t i = 0;
+		for (; i + STRIPE <= bytes.size(); i += STRIPE, stripe_key += PRIME) {
+			std::array<std::uint64_t, LANES> words{};
+			std::memcpy(words.data(), bytes.data() + i, STRIPE);
+			for (std::size_t lane = 0; lane < LANES; lane++) {
+				const std::uint64_t keyed = words[lane] ^ (SECRET[lane] + stripe_key);
+				accumulators[lane] += words[lane ^ 1] + (keyed & 0xFFFFFFFF) * (keyed >> 32);
+			}
+		}
+
+		std::uint64_t hash = bytes.size() * PRIME;
+		for (; i < bytes.size(); i++)
+			hash = (hash ^ static_cast<std::uint8_t>(bytes[i])) * PRIME;
+		for (const std::uint64_t accumulator : accumulators)
+			hash = std::rotl(hash ^ (accumulator * PRIME), 31) * PRIME;
+		return hash ^ (hash >> 29);
+	}
+
+	struct RegionHashes {
+		std::uintptr_t address;
+		std::size_t length;
+		// One hash per page, the last page may be partial
+		std::vector<std::uint64_t> pages;
+	};
+
+	struct HashDifference {
+		// Pages whose contents changed, inside regions that kept their address and length
+		std::vector<std::uintptr_t> changed_pages;
+		// Regions that were hashed for the first time, including the ones that changed their length
+		std::vector<std::uintptr_t> added_regions;
+		// Regions that are no longer part of the layout or no longer selected
+		std::vector<std::uintptr_t> removed_regions;
+	};
+
+	/**
+	 * Keeps a hash of every page of the selected regions and reports which of them changed since the previous run.
+	 * Work is split into runs of pages, so large regions are spread over multiple threads.
+	 * Regions without live views are read through the memory manager if it is a Reader.
+	 */
+	template <typename MemMgr>
+		requires Traversable<MemMgr>
+	class PageHasher {
+	public:
+		using RegionT = typename MemMgr::RegionT;
+		using Filter = std::function<bool(const RegionT&)>;
+
+	private:
+		static constexpr std::size_t PAGES_PER_TASK = 256;
+
+		const MemMgr* manager;
+		Filter filter;
+		std::size_t thread_count = 0;
+
+		std::map<std::uintptr_t, RegionHashes> regions;
+
+		[[nodiscard]] std::size_t get_page_size() const
+		{
+			if constexpr (GranularityAware<MemMgr>)
+				return manager->get_page_granularity();
+			else
+				return 4096;
+		}
+
+		// Mirrors the default flags of the traversal
+		[[nodiscard]] static bool is_readable(const RegionT& region)
+		{
+			if constexpr (FlagAware<RegionT>)
+				return region.get_flags().is_readable();
+			return true;
+		}
+
+		/**
+		 * Hashes the regions that the filter selects from the current layout.
+		 * @returns the hashes, sorted by address
+		 */
+		[[nodiscard]] std::vector<RegionHashes> hash_regions(const std::function<bool(const RegionT&)>& region_filter) const
+		{
+			const std::size_t page_size = get_page_size();
+			// Calls are never concurrent
+			std::vector<std::uintptr_t> failed_regions;
+			const RegionTraversal<MemMgr> traversal{ *manager, {
+				.chunk_size = PAGES_PER_TASK * page_size,
+				.thread_count = thread_count,
+				.filter = region_filter,
+				.on_read_failure = [&failed_regions](const RegionT& region, std::uintptr_t, std::exception_ptr) { failed_regions.push_back(region.get_address()); },
+			} };
+
+			// Every region is split into runs of pages, so the hashes are allocated before the threads start
+			std::vector<RegionHashes> hashes;
+			for (const RegionT& region : manager->get_layout())
+				if (region.get_length() > 0 && is_readable(region) && region_filter(region))
+					hashes.push_back(RegionHashes{
+						.address = region.get_address(),
+						.length = region.get_length(),
+						.pages = std::vector<std::uint64_t>((region.get_length() + page_size - 1) / page_size),
+					});
+			std::ranges::sort(hashes, {}, &RegionHashes::address);
+
+			traversal.run([&](std::uintptr_t address, std::span<const std::byte> bytes) {
+				auto region = std::ranges::upper_bound(hashes, address, {}, &RegionHashes::address);
+				--region;
+				const std::size_t first_page = (address - region->address) / page_size;
+				for (std::size_t offset = 0; offset < bytes.size(); offset += page_size)
+					region->pages[first_page + offset / page_size] = hash_page(bytes.subspan(offset, std::min(page_size, bytes.size() - offset)));
+			});
+
+			// Regions that couldn't be read completely are left out, as if they weren't selected
+			std::erase_if(hashes, [&failed_regions](const RegionHashes& region) { return std::ranges::find(failed_regions, region.address) != failed_regions.end(); });
+			return hashes;
+		}
+
+	public:
+		/**
+		 * @param filter selects the regions that are hashed, unreadable regions and regions that fail to be read are always skipped.
+		 *   A common choice is executable regions that are backed by a file.
+		 */
+		explicit PageHasher(const MemMgr& manager, Filter filter = {})
+			: manager(&manager)
+			, filter(std::move(filter))
+		{
+		}
+
+		// 0 uses the hardware concurrency
+		void set_thread_count(std::size_t new_thread_count) noexcept
+		{
+			thread_count = new_thread_count;
+		}
+
+		[[nodiscard]] const std::map<std::uintptr_t, RegionHashes>& get_hashes() const noexcept
+		{
+			return regions;
+		}
+
+		[[nodiscard]] const RegionHashes* get_hashes(std::uintptr_t region_address) const
+		{
+			const auto it = regions.find(region_address);
+			return it == regions.end() ? nullptr : &it->second;
+		}
+
+		void clear() noexcept
+		{
+			regions.clear();
+		}
+
+		/**
+		 * Hashes all selected regions of the current layout and compares them to the previous run.
+		 * The first run reports every region as added.
+		 */
+		HashDifference rehash()
+		{
+			std::vector<RegionHashes> hashes = hash_regions([this](const RegionT& region) { return !filter || filter(region); });
+
+			HashDifference difference;
+			std::map<std::uintptr_t, RegionHashes> next_regions;
+			for (RegionHashes& region : hashes) {
+				const auto previous = regions.find(region.address);
+				if (previous == regions.end() || previous->second.length != region.length)
+					difference.added_regions.push_back(region.address);
+				else
+					diff(previous->second, region, difference.changed_pages);
+				next_regions.emplace(region.address, std::move(region));
+			}
+
+			for (const auto& [address, region] : regions)
+				if (!next_regions.contains(address))
+					difference.removed_regions.push_back(address);
+
+			regions = std::move(next_regions);
+			return difference;
+		}
+
+		/**
+		 * Rehashes a single region of the current layout, the hashes of all other regions are left untouched.
+		 * @returns the changed pages, or every page if the region wasn't known before or changed its length
+		 */
+		std::vector<std::uintptr_t> rehash(const RegionT& region)
+		{
+			std::vector<RegionHashes> hashes = hash_regions([&region](const RegionT& candidate) { return candidate.get_address() == region.get_address(); });
+			if (hashes.empty())
+				throw std::invalid_argument{ "Region is not part of the layout or not readable" };
+
+			const std::size_t page_size = get_page_size();
+			std::vector<std::uintptr_t> changed_pages;
+			const auto previous = regions.find(region.get_address());
+			if (previous == regions.end() || previous->second.length != hashes.front().length) {
+				for (std::size_t page = 0; page < hashes.front().pages.size(); page++)
+					changed_pages.push_back(region.get_address() + page * page_size);
+			} else
+				diff(previous->second, hashes.front(), changed_pages);
+
+			regions.insert_or_assign(region.get_address(), std::move(hashes.front()));
+			return changed_pages;
+		}
+
+	private:
+		void diff(const RegionHashes& previous, const RegionHashes& current, std::vector<std::uintptr_t>& changed_pages) const
+		{
+			const std::size_t page_size = get_page_size();
+			for (std::size_t page = 0; page < current.pages.size(); page++)
+				if (previous.pages[page] != current.pages[page])
+					changed_pages.push_back(current.address + page * page_size);
+		}
+	};
+
+	struct IgnoredSpan {
+		std::uintptr_t address;
+		std::size_t length;
+	};
+
+	/**
+	 * Compares a file backed region with the contents of its file on disk.
+	 * @param ignored spans that are expected to differ, for example relocations applied by the loader
+	 * @param page_size granularity of the comparison
+	 * @returns the addresses of the pages that differ, bytes past the end of the file are not compared
+	 */
+	template <typename Region>
+		requires AddressAware<Region> && PathAware<Region> && OffsetAware<Region> && Viewable<Region>
+	[[nodiscard]] std::vector<std::uintptr_t> find_modified_pages(const Region& region, std::span<const IgnoredSpan> ignored = {}, std::size_t page_size = 4096)
+	{
+		const std::optional<std::string> path = region.get_path();
+		if (!path.has_value())
+			throw std::invalid_argument{ "Region is not backed by a file" };
+
+		std::ifstream file{ *path, std::ios::binary };
+		if (!file)
+			throw std::runtime_error{ "Failed to open " + *path };
+
+		const auto memory = region.view();
+		std::vector<std::byte> disk(memory.size());
+		file.seekg(static_cast<std::streamoff>(region.get_offset()));
+		file.read(reinterpret_cast<char*>(disk.data()), static_cast<std::streamsize>(disk.size()));
+		const auto available = static_cast<std::size_t>(std::max<std::streamsize>(file.gcount(), 0));
+
+		// Ignored bytes are masked in both copies, so they can't contribute to a difference
+		std::vector<std::byte> masked{ memory.begin(), memory.begin() + static_cast<std::ptrdiff_t>(available) };
+		for (const IgnoredSpan& span : ignored) {
+			const std::uintptr_t begin = std::max(span.address, region.get_address());
+			const std::uintptr_t end = std::min(span.address + span.length, region.get_address() + available);
+			if (begin >= end)
+				continue;
+			std::fill(masked.begin() + static_cast<std::ptrdiff_t>(begin - region.get_address()), masked.begin() + static_cast<std::ptrdiff_t>(end - region.get_address()), std::byte{});
+			std::fill(disk.begin() + static_cast<std::ptrdiff_t>(begin - region.get_address()), disk.begin() + static_cast<std::ptrdiff_t>(end - region.get_address()), std::byte{});
+		}
+
+		std::vector<std::uintptr_t> modified_pages;
+		for (std::size_t offset = 0; offset < available; offset += page_size) {
+			const std::size_t length = std::min(page_size, available - offset);
+			const std::span live{ masked.data() + offset, length };
+			const std::span stored{ disk.data() + offset, length };
+			if (!std::ranges::equal(live, stored))
+				modified_pages.push_back(region.get_address() + offset);
+		}
+		return modified_pages;
+	}
+}
+
+#endif
@@ -0,0 +1,315 @@
+#ifndef MEMORYMANAGER_PATCHMANAGER_HPP
+#define MEMORYMANAGER_PATCHMANAGER_HPP
+
+#include "MemoryManager/MemoryManager.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace MemoryManager {
+	/**
+	 * Manages a set of byte patches, which are applied and restored in batches.
+	 *
+	 * If the memory manager needs permissions for writing, all pages of a batch that aren't writable are collected,
+	 * adjacent pages with the same protection are merged and every resulting range is unprotected and reprotected
+	 * only once per batch. The original bytes are read the same way if the manager needs permissions for reading.
+	 * The original protection is taken from the layout, so it should be up to date.
+	 * Instruction caches are flushed once per batch for local memory managers.
+	 */
+	template <typename MemMgr>
+		requires Reader<MemMgr> && Writer<MemMgr>
+		&& ((!MemMgr::REQUIRES_PERMISSIONS_FOR_READING && !MemMgr::REQUIRES_PERMISSIONS_FOR_WRITING)
+			|| (Protector<MemMgr> && GranularityAware<MemMgr> && LayoutAware<MemMgr> && FlagAware<typename MemMgr::RegionT>))
+	class PatchManager {
+	public:
+		using PatchId = std::size_t;
+
+	private:
+		struct Patch {
+			std::uintptr_t address;
+			std::vector<std::byte> replacement;
+			std::vector<std::byte> original;
+			bool active;
+			// Tracked per patch, so a batch that failed halfway can still be reverted
+			bool applied;
+		};
+
+		struct Write {
+			std::uintptr_t address;
+			std::span<const std::byte> bytes;
+		};
+
+		enum class Access : std::uint8_t {
+			READ,
+			WRITE,
+		};
+
+		struct ProtectedRange {
+			std::uintptr_t address;
+			std::size_t length;
+			Flags flags;
+		};
+
+		const MemMgr* manager;
+		std::vector<Patch> patches;
+		std::vector<PatchId> free_ids;
+		bool enabled = false;
+
+		[[nodiscard]] std::size_t get_page_size() const
+		{
+			if constexpr (GranularityAware<MemMgr>)
+				return manager->get_page_granularity();
+			else
+				return 4096;
+		}
+
+		[[nodiscard]] std::vector<std::uintptr_t> collect_pages(std::span<const Write> writes) const
+		{
+			const std::size_t page_size = get_page_size();
+			std::vector<std::uintptr_t> pages;
+			for (const Write& write : writes)
+				for (std::uintptr_t page = write.address / page_size * page_size; page < write.address + write.bytes.size(); page += page_size)
+					pages.push_back(page);
+			std::ranges::sort(pages);
+			const auto [first, last] = std::ranges::unique(pages);
+			pages.erase(first, last);
+			return pages;
+		}
+
+		// Makes every page accessible that isn't already and returns what has to be restored afterward
+		[[nodiscard]] std::vector<ProtectedRange> unprotect(std::span<const std::uintptr_t> pages, Access access) const
+		{
+			const std::size_t page_size = get_page_size();
+			std::vector<ProtectedRange> ranges;
+			for (const std::uintptr_t page : pages) {
+				const auto* region = manager->get_layout().find_region(page);
+				if (region == nullptr)
+					throw std::runtime_error{ "Patch targets unmapped memory" };
+
+				const Flags flags = region->get_flags();
+				if (access == Access::WRITE ? flags.is_writeable() : flags.is_readable())
+					continue;
+
+				if (!ranges.empty() && ranges.back().address + ranges.back().length == page && ranges.back().flags == flags)
+					ranges.back().length += page_size;
+				else
+					ranges.push_back(ProtectedRange{ .address = page, .length = page_size, .flags = flags });
+			}
+
+			for (std::size_t i = 0; i < ranges.size(); i++) {
+				Flags accessible = ranges[i].flags;
+				// Executable pages stay executable, other threads may be running code on them
+				if (access == Access::WRITE)
+					accessible.set_writeable(true);
+				else
+					accessible.set_readable(true);
+				try {
+					manager->protect(ranges[i].address, ranges[i].length, accessible);
+				} catch (...) {
+					reprotect(std::span{ ranges }.first(i));
+					throw;
+				}
+			}
+
+			return ranges;
+		}
+
+		void reprotect(std::span<const ProtectedRange> ranges) const
+		{
+			for (const ProtectedRange& range : ranges)
+				manager->protect(range.address, range.length, range.flags);
+		}
+
+		void flush_instruction_cache(std::span<const std::uintptr_t> pages) const
+		{
+			if constexpr (LocalAware<MemMgr>) {
+				if constexpr (MemMgr::IS_LOCAL) {
+					const std::size_t page_size = get_page_size();
+					// Adjacent pages are flushed together
+					for (std::size_t i = 0; i < pages.size();) {
+						std::size_t j = i + 1;
+						while (j < pages.size() && pages[j] == pages[j - 1] + page_size)
+							j++;
+						__builtin___clear_cache(reinterpret_cast<char*>(pages[i]), reinterpret_cast<char*>(pages[j - 1] + page_size));
+						i = j;
+					}
+				}
+			}
+		}
+
+		// Counts the writes that have landed in written, so a failing batch can be accounted for
+		void write_batch(std::span<const Write> writes, std::size_t& written) const
+		{
+			if (writes.empty())
+				return;
+
+			const auto pages = collect_pages(writes);
+
+			auto write_all = [&] {
+				for (const Write& write : writes) {
+					manager->write(write.address, write.bytes.data(), write.bytes.size());
+					written++;
+				}
+			};
+
+			if constexpr (MemMgr::REQUIRES_PERMISSIONS_FOR_WRITING) {
+				const auto ranges = unprotect(pages, Access::WRITE);
+				try {
+					write_all();
+				} catch (...) {
+					reprotect(ranges);
+					flush_instruction_cache(pages);
+					throw;
+				}
+				reprotect(ranges);
+			} else {
+				try {
+					write_all();
+				} catch (...) {
+					flush_instruction_cache(pages);
+					throw;
+				}
+			}
+
+			flush_instruction_cache(pages);
+		}
+
+		void read_original(std::uintptr_t address, std::span<std::byte> original) const
+		{
+			if constexpr (MemMgr::REQUIRES_PERMISSIONS_FOR_READING) {
+				const Write range{ .address = address, .bytes = original };
+				const auto ranges = unprotect(collect_pages(std::span{ &range, 1 }), Access::READ);
+				try {
+					manager->read(address, original.data(), original.size());
+				} catch (...) {
+					reprotect(ranges);
+					throw;
+				}
+				reprotect(ranges);
+			} else
+				manager->read(address, original.data(), original.size());
+		}
+
+		[[nodiscard]] Patch& get_patch(PatchId id)
+		{
+			if (id >= patches.size() || !patches[id].active)
+				throw std::out_of_range{ "Unknown patch" };
+			return patches[id];
+		}
+
+	public:
+		explicit PatchManager(const MemMgr& manager)
+			: manager(&manager)
+		{
+		}
+
+		// Restoring on destruction would throw if the memory is already gone, so patches stay as they are
+		~PatchManager() = default;
+
+		PatchManager(const PatchManager& other) = delete;
+		PatchManager& operator=(const PatchManager& other) = delete;
+
+		/**
+		 * Adds a patch, the original bytes are read immediately.
+		 * If the manager is enabled, the patch is applied right away.
+		 * @throws std::invalid_argument if the patch overlaps another patch
+		 */
+		PatchId add(std::uintptr_t address, std::span<const std::byte> replacement)
+		{
+			if (replacement.empty())
+				throw std::invalid_argument{ "Patches must replace at least one byte" };
+
+			for (const Patch& patch : patches)
+				if (patch.active && address < patch.address + patch.replacement.size() && patch.address < address + replacement.size())
+					throw std::invalid_argument{ "Patch overlaps an existing patch" };
+
+			Patch patch{
+				.address = address,
+				.replacement = { replacement.begin(), replacement.end() },
+				.original = std::vector<std::byte>(replacement.size()),
+				.active = true,
+				.applied = false,
+			};
+			read_original(address, patch.original);
+
+			if (enabled) {
+				const Write write{ .address = address, .bytes = patch.replacement };
+				std::size_t written = 0;
+				write_batch(std::span{ &write, 1 }, written);
+				patch.applied = true;
+			}
+
+			if (!free_ids.empty()) {
+				const PatchId id = free_ids.back();
+				free_ids.pop_back();
+				patches[id] = std::move(patch);
+				return id;
+			}
+			patches.push_back(std::move(patch));
+			return patches.size() - 1;
+		}
+
+		// Removes a patch, if it is applied the original bytes are restored
+		void remove(PatchId id)
+		{
+			Patch& patch = get_patch(id);
+			if (patch.applied) {
+				const Write write{ .address = patch.address, .bytes = patch.original };
+				std::size_t written = 0;
+				write_batch(std::span{ &write, 1 }, written);
+			}
+			patch = {};
+			free_ids.push_back(id);
+		}
+
+		[[nodiscard]] std::size_t size() const noexcept
+		{
+			return patches.size() - free_ids.size();
+		}
+
+		[[nodiscard]] bool is_enabled() const noexcept
+		{
+			return enabled;
+		}
+
+		/**
+		 * Applies or restores all patches in a single batch.
+		 * If a write fails, the patches written before it keep their new state and the manager keeps its old one.
+		 * Calling this again, with either value, then retries or reverts exactly the patches that need it.
+		 */
+		void set_enabled(bool new_enabled)
+		{
+			std::vector<Write> writes;
+			std::vector<Patch*> targets;
+			for (Patch& patch : patches)
+				if (patch.active && patch.applied != new_enabled) {
+					writes.push_back(Write{ .address = patch.address, .bytes = new_enabled ? patch.replacement : patch.original });
+					targets.push_back(&patch);
+				}
+
+			std::size_t written = 0;
+			try {
+				write_batch(writes, written);
+			} catch (...) {
+				for (std::size_t i = 0; i < written; i++)
+					targets[i]->applied = new_enabled;
+				throw;
+			}
+
+			for (Patch* patch : targets)
+				patch->applied = new_enabled;
+			enabled = new_enabled;
+		}
+
+		void toggle()
+		{
+			set_enabled(!enabled);
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,393 @@
+#ifndef MEMORYMANAGER_REGIONTRAVERSAL_HPP
+#define MEMORYMANAGER_REGIONTRAVERSAL_HPP
+
+#include "MemoryManager/MemoryManager.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace MemoryManager {
+	template <typename MemMgr>
+	concept Traversable = LayoutAware<MemMgr>
+		&& AddressAware<typename MemMgr::RegionT>
+		&& LengthAware<typename MemMgr::RegionT>
+		&& (Viewable<typename MemMgr::RegionT> || Reader<MemMgr>);
+
+	/**
+	 * Splits the regions of a layout into page aligned chunks and hands them to a kernel on a pool of threads.
+	 *
+	 * Every thread owns a queue of work. Regions are distributed over the queues up front, a thread splits one chunk
+	 * at a time off the region it is working on and puts the remainder back, where idle threads can steal it.
+	 * This keeps the threads busy even if a single region is much larger than all others combined.
+	 * Threads that find nothing to steal sleep until a remainder is put back or the traversal ends.
+	 * Regions that fail to be read are skipped from the failing chunk on, only exceptions thrown by the kernel stop the traversal.
+	 */
+	template <typename MemMgr>
+		requires Traversable<MemMgr>
+	class RegionTraversal {
+	public:
+		using RegionT = typename MemMgr::RegionT;
+
+		struct Options {
+			// Rounded up to the page granularity, 0 passes whole regions to the kernel
+			std::size_t chunk_size = std::size_t{ 1 } << 20;
+			// Bytes of the following chunk that are appended to every chunk, for matches that cross chunk borders
+			std::size_t overlap = 0;
+			// 0 uses the hardware concurrency
+			std::size_t thread_count = 0;
+
+			// Only regions that have all required and none of the forbidden flags are traversed
+			Flags required_flags{ true, false, false };
+			Flags forbidden_flags{ false, false, false };
+			// Selects shared or private regions, both if empty
+			std::optional<bool> shared{};
+			std::function<bool(const std::optional<std::string>&)> name_filter{};
+			std::function<bool(const RegionT&)> filter{};
+
+			// Regions whose views don't update are read chunk by chunk through the manager, so the data is current
+			// and the memory usage is bounded by the chunk size (entire regions are read if it is 0).
+			// Disable this for managers whose constant views are cheap to obtain.
+			bool read_through_manager = true;
+
+			// Runs of pages that aren't backed by memory in private anonymous regions read as zeros, these are skipped if the
+			// regions can tell (PresenceAware). Occurrences that begin in a skipped page are missed.
+			bool skip_absent_pages = false;
+
+			// Invoked once for every region that is skipped because a chunk of it couldn't be read, with the address of that
+			// chunk and the exception of the read. Invocations come from the worker threads, but never at the same time.
+			std::function<void(const RegionT&, std::uintptr_t, std::exception_ptr)> on_read_failure{};
+		};
+
+	private:
+		struct Task {
+			std::size_t region;
+			std::size_t begin;
+			std::size_t end;
+		};
+
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		struct RegionState {
+			const RegionT* region;
+			bool live_view;
+			std::once_flag view_once;
+			std::span<const std::byte> view;
+			// Set once a chunk couldn't be read, the remaining chunks of the region are dropped
+			std::atomic_bool failed = false;
+		};
+
+		const MemMgr* manager;
+		Options options;
+
+		[[nodiscard]] std::size_t get_page_size() const
+		{
+			if constexpr (GranularityAware<MemMgr>)
+				return manager->get_page_granularity();
+			else
+				return 4096;
+		}
+
+		[[nodiscard]] bool is_selected(const RegionT& region) const
+		{
+			if constexpr (FlagAware<RegionT>) {
+				const Flags flags = region.get_flags();
+				if ((flags & options.required_flags) != options.required_flags || (flags & options.forbidden_flags).any())
+					return false;
+			}
+			if constexpr (SharedAware<RegionT>)
+				if (options.shared.has_value() && static_cast<bool>(region.is_shared()) != *options.shared)
+					return false;
+			if constexpr (NameAware<RegionT>)
+				if (options.name_filter && !options.name_filter(region.get_name()))
+					return false;
+			return !options.filter || options.filter(region);
+		}
+
+		[[nodiscard]] static bool has_live_view(const RegionT& region)
+		{
+			if constexpr (Viewable<RegionT>)
+				return region.does_update_view();
+			return false;
+		}
+
+		// Adds a task for every run of pages of the region that needs to be traversed
+		void add_tasks(std::size_t index, const RegionT& region, std::vector<Task>& tasks) const
+		{
+			if constexpr (PresenceAware<RegionT>) {
+				if (options.skip_absent_pages && region.is_private_anonymous()) {
+					const std::size_t page_size = get_page_size();
+					const std::size_t page_count = (region.get_length() + page_size - 1) / page_size;
+
+					std::optional<decltype(region.get_page_presence())> presence;
+					try {
+						presence.emplace(region.get_page_presence());
+					} catch (const std::exception&) {
+						// The whole region is traversed, if it can't tell which pages are present
+					}
+
+					if (presence.has_value()) {
+						for (std::size_t page = 0; page < page_count;) {
+							if (!presence->is_present(page)) {
+								page++;
+								continue;
+							}
+							std::size_t end = page + 1;
+							while (end < page_count && presence->is_present(end))
+								end++;
+							tasks.push_back(Task{ .region = index, .begin = page * page_size, .end = std::min(end * page_size, region.get_length()) });
+							page = end;
+						}
+						return;
+					}
+				}
+			}
+			tasks.push_back(Task{ .region = index, .begin = 0, .end = region.get_length() });
+		}
+
+		[[nodiscard]] bool reads_chunks(const RegionState& state) const
+		{
+			if constexpr (!Reader<MemMgr>)
+				return false;
+			else if constexpr (!Viewable<RegionT>)
+				return true;
+			else
+				return !state.live_view && options.read_through_manager;
+		}
+
+		// Returns the bytes of [begin, end) of a region, buffer is used if the bytes need to be copied
+		[[nodiscard]] std::span<const std::byte> fetch(RegionState& state, std::size_t begin, std::size_t end, std::vector<std::byte>& buffer) const
+		{
+			if (reads_chunks(state)) {
+				if constexpr (Reader<MemMgr>) {
+					buffer.resize(end - begin);
+					manager->read(state.region->get_address() + begin, buffer.data(), end - begin);
+					return buffer;
+				}
+			}
+
+			if constexpr (Viewable<RegionT>) {
+				// Copies are refreshed once per traversal, which must not happen concurrently
+				std::call_once(state.view_once, [&state] { state.view = state.live_view ? state.region->view() : state.region->view(true); });
+				return state.view.subspan(begin, end - begin);
+			}
+
+			return {};
+		}
+
+	public:
+		explicit RegionTraversal(const MemMgr& manager, Options options = {})
+			: manager(&manager)
+			, options(std::move(options))
+		{
+		}
+
+		[[nodiscard]] const Options& get_options() const noexcept
+		{
+			return options;
+		}
+
+		/**
+		 * @returns the size of a chunk without its overlap, the kernel receives spans that are at most this plus the overlap.
+		 * A match that begins at or after this offset into a span belongs to the next chunk,
+		 * skipping those avoids reporting matches in the overlap twice.
+		 */
+		[[nodiscard]] std::size_t get_chunk_size() const
+		{
+			if (options.chunk_size == 0)
+				return static_cast<std::size_t>(-1);
+			const std::size_t page_size = get_page_size();
+			return (options.chunk_size + page_size - 1) / page_size * page_size;
+		}
+
+		/**
+		 * Invokes kernel(address, span) for every chunk of every selected region.
+		 * Kernels may return a bool, returning false stops the traversal early.
+		 * The first exception thrown by a kernel (or on_read_failure) stops the traversal and is rethrown.
+		 * @returns true if every chunk has been visited, false if the traversal was stopped or canceled
+		 */
+		template <typename Kernel>
+			requires std::is_invocable_v<Kernel&, std::uintptr_t, std::span<const std::byte>>
+		bool run(Kernel&& kernel, std::stop_token stop_token = {}) const
+		{
+			std::deque<RegionState> regions;
+			for (const RegionT& region : manager->get_layout())
+				if (is_selected(region) && region.get_length() > 0)
+					regions.emplace_back(&region, has_live_view(region));
+
+			std::size_t thread_count = options.thread_count;
+			if (thread_count == 0)
+				thread_count = std::max(1U, std::thread::hardware_concurrency());
+
+			std::vector<Task> tasks;
+			for (std::size_t i = 0; i < regions.size(); i++)
+				add_tasks(i, *regions[i].region, tasks);
+
+			const std::size_t chunk_size = get_chunk_size();
+			std::size_t total_chunks = 0;
+			for (const Task& task : tasks)
+				total_chunks += (task.end - task.begin - 1) / chunk_size + 1;
+			thread_count = std::max<std::size_t>(1, std::min(thread_count, total_chunks));
+
+			// Largest tasks first, dealt out round robin, so every queue starts with a similar amount of work
+			std::ranges::sort(tasks, std::greater{}, [](const Task& task) { return task.end - task.begin; });
+
+			std::deque<Queue> queues(thread_count);
+			for (std::size_t i = 0; i < tasks.size(); i++)
+				queues[i % thread_count].tasks.push_back(tasks[i]);
+
+			// Tasks that are queued or being worked on, the traversal ends once this reaches zero
+			std::atomic_size_t outstanding = tasks.size();
+			// Tasks that are waiting in a queue
+			std::atomic_size_t queued = tasks.size();
+			std::stop_source stop_source;
+			std::exception_ptr exception;
+			std::mutex exception_mutex;
+			std::mutex failure_mutex;
+
+			auto stopped = [&] { return stop_source.stop_requested() || stop_token.stop_requested(); };
+
+			// Idle threads sleep until work is put back, the traversal ends or it is stopped
+			std::mutex idle_mutex;
+			std::condition_variable idle_condition;
+			auto wake = [&](bool all) {
+				// Taking the lock orders the notification after the check of a thread that is about to sleep
+				{
+					const std::scoped_lock lock{ idle_mutex };
+				}
+				if (all)
+					idle_condition.notify_all();
+				else
+					idle_condition.notify_one();
+			};
+			const std::stop_callback wake_on_cancel{ stop_token, [&] { wake(true); } };
+
+			auto take = [&](std::size_t self) -> std::optional<Task> {
+				{
+					Queue& own = queues[self];
+					const std::scoped_lock lock{ own.mutex };
+					if (!own.tasks.empty()) {
+						const Task task = own.tasks.back();
+						own.tasks.pop_back();
+						queued--;
+						return task;
+					}
+				}
+				for (std::size_t offset = 1; offset < thread_count; offset++) {
+					Queue& victim = queues[(self + offset) % thread_count];
+					const std::scoped_lock lock{ victim.mutex };
+					if (!victim.tasks.empty()) {
+						const Task task = victim.tasks.front();
+						victim.tasks.pop_front();
+						queued--;
+						return task;
+					}
+				}
+				return std::nullopt;
+			};
+
+			auto worker = [&](std::size_t self) {
+				std::vector<std::byte> buffer;
+				while (outstanding > 0 && !stopped()) {
+					std::optional<Task> task = take(self);
+					if (!task.has_value()) {
+						// Other threads are still working and may put back remainders
+						std::unique_lock lock{ idle_mutex };
+						idle_condition.wait(lock, [&] { return queued > 0 || outstanding == 0 || stopped(); });
+						continue;
+					}
+
+					RegionState& state = regions[task->region];
+					if (state.failed) {
+						if (--outstanding == 0)
+							wake(true);
+						continue;
+					}
+
+					const std::size_t length = state.region->get_length();
+					const std::size_t chunk_end = task->end - task->begin > chunk_size ? task->begin + chunk_size : task->end;
+					if (chunk_end < task->end) {
+						{
+							Queue& own = queues[self];
+							const std::scoped_lock lock{ own.mutex };
+							outstanding++;
+							queued++;
+							own.tasks.push_back(Task{ .region = task->region, .begin = chunk_end, .end = task->end });
+						}
+						wake(false);
+					}
+
+					try {
+						const std::size_t span_end = std::min(length, chunk_end + options.overlap);
+						const std::uintptr_t address = state.region->get_address() + task->begin;
+
+						std::span<const std::byte> span;
+						bool fetched = true;
+						try {
+							span = fetch(state, task->begin, span_end, buffer);
+						} catch (...) {
+							// The remainders of the region are dropped as they are taken
+							fetched = false;
+							if (!state.failed.exchange(true) && options.on_read_failure) {
+								const std::scoped_lock lock{ failure_mutex };
+								options.on_read_failure(*state.region, address, std::current_exception());
+							}
+						}
+
+						if (fetched) {
+							if constexpr (std::is_same_v<std::invoke_result_t<Kernel&, std::uintptr_t, std::span<const std::byte>>, bool>) {
+								if (!kernel(address, span)) {
+									stop_source.request_stop();
+									wake(true);
+								}
+							} else
+								kernel(address, span);
+						}
+					} catch (...) {
+						{
+							const std::scoped_lock lock{ exception_mutex };
+							if (!exception)
+								exception = std::current_exception();
+						}
+						stop_source.request_stop();
+						wake(true);
+					}
+
+					if (--outstanding == 0)
+						wake(true);
+				}
+			};
+
+			{
+				std::vector<std::jthread> threads;
+				threads.reserve(thread_count - 1);
+				for (std::size_t i = 1; i < thread_count; i++)
+					threads.emplace_back(worker, i);
+				worker(0);
+			}
+
+			if (exception)
+				std::rethrow_exception(exception);
+
+			return !stopped();
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,699 @@
+#ifndef MEMORYMANAGER_STRINGSEARCH_HPP
+#define MEMORYMANAGER_STRINGSEARCH_HPP
+
+#include "MemoryManager/MemoryManager.hpp"
+#include "MemoryManager/RegionTraversal.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace MemoryManager {
+	enum class StringEncoding : std::uint8_t {
+		ASCII = 1 << 0,
+		UTF8 = 1 << 1,
+		UTF16LE = 1 << 2,
+	};
+
+	constexpr StringEncoding operator|(StringEncoding lhs, StringEncoding rhs) noexcept
+	{
+		return static_cast<StringEncoding>(static_cast<std::uint8_t>(lhs) | static_cast<std::uint8_t>(rhs));
+	}
+
+	constexpr bool operator&(StringEncoding lhs, StringEncoding rhs) noexcept
+	{
+		return (static_cast<std::uint8_t>(lhs) & static_cast<std::uint8_t>(rhs)) != 0;
+	}
+
+	struct StringExtractionOptions {
+		// Multiple encodings can be combined, runs that are pure ASCII are reported as ASCII if it is requested
+		StringEncoding encodings = StringEncoding::ASCII | StringEncoding::UTF16LE;
+		// Measured in characters
+		std::size_t min_length = 4;
+		// UTF-16 runs are limited to the ASCII subset unless this is set, since most binary data consists of printable BMP code units.
+		// Runs may then contain any printable BMP character, but surrogate pairs still end them.
+		bool utf16_beyond_ascii = false;
+	};
+
+	struct FoundString {
+		std::uintptr_t address;
+		StringEncoding encoding;
+		// Size of the string in the target memory
+		std::size_t byte_length;
+		// Contents converted to UTF-8
+		std::string text;
+	};
+
+	struct NeedleMatch {
+		std::uintptr_t address;
+		std::size_t needle;
+	};
+
+	namespace Strings {
+		[[nodiscard]] constexpr bool is_printable(std::uint8_t byte) noexcept
+		{
+			return (byte >= 0x20 && byte <= 0x7E) || byte == '\t';
+		}
+
+		// Bit i is set if byte i of the block is printable ASCII
+		[[nodiscard]] inline std::uint32_t printable_mask(const std::byte* block) noexcept
+		{
+#ifdef __SSE2__
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+			// Bytes above 0x7F are negative when compared as signed integers
+			const __m128i printable = _mm_and_si128(
+				_mm_cmpgt_epi8(bytes, _mm_set1_epi8(0x1F)),
+				_mm_cmplt_epi8(bytes, _mm_set1_epi8(0x7F)));
+			const __m128i tab = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t'));
+			return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_or_si128(printable, tab)));
+#else
+			std::uint32_t mask = 0;
+			for (std::size_t i = 0; i < 16; i++)
+				mask |= is_printable(static_cast<std::uint8_t>(block[i])) ? 1U << i : 0;
+			return mask;
+#endif
+		}
+
+		// Bit i is set if byte i of the block is zero
+		[[nodiscard]] inline std::uint32_t zero_mask(const std::byte* block) noexcept
+		{
+#ifdef __SSE2__
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+			return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_setzero_si128())));
+#else
+			std::uint32_t mask = 0;
+			for (std::size_t i = 0; i < 16; i++)
+				mask |= block[i] == std::byte{} ? 1U << i : 0;
+			return mask;
+#endif
+		}
+
+		// Bit i is set if byte i of the block is not ASCII
+		[[nodiscard]] inline std::uint32_t high_mask(const std::byte* block) noexcept
+		{
+#ifdef __SSE2__
+			return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block))));
+#else
+			std::uint32_t mask = 0;
+			for (std::size_t i = 0; i < 16; i++)
+				mask |= static_cast<std::uint8_t>(block[i]) >= 0x80 ? 1U << i : 0;
+			return mask;
+#endif
+		}
+
+		constexpr std::size_t BLOCK_SIZE = 16;
+		constexpr std::uint32_t FULL_BLOCK = (1U << BLOCK_SIZE) - 1;
+
+		/**
+		 * Decodes a multi-byte UTF-8 sequence, overlong encodings and surrogates are rejected.
+		 * @returns the length of the sequence or 0 if it is invalid
+		 */
+		[[nodiscard]] inline std::size_t decode_utf8_sequence(std::span<const std::byte> bytes, std::uint32_t& code_point) noexcept
+		{
+			const auto lead = static_cast<std::uint8_t>(bytes[0]);
+			std::size_t length = 0;
+			if ((lead & 0xE0) == 0xC0) {
+				length = 2;
+				code_point = lead & 0x1F;
+			} else if ((lead & 0xF0) == 0xE0) {
+				length = 3;
+				code_point = lead & 0x0F;
+			} else if ((lead & 0xF8) == 0xF0) {
+				length = 4;
+				code_point = lead & 0x07;
+			} else
+				return 0;
+
+			if (bytes.size() < length)
+				return 0;
+
+			for (std::size_t i = 1; i < length; i++) {
+				const auto continuation = static_cast<std::uint8_t>(bytes[i]);
+				if ((continuation & 0xC0) != 0x80)
+					return 0;
+				code_point = (code_point << 6) | (continuation & 0x3F);
+			}
+
+			static constexpr std::array<std::uint32_t, 5> MINIMUM{ 0, 0, 0x80, 0x800, 0x10000 };
+			if (code_point < MINIMUM[length] || code_point > 0x10FFFF)
+				return 0;
+			if (code_point >= 0xD800 && code_point <= 0xDFFF)
+				return 0;
+			return length;
+		}
+
+		/**
+		 * Validates a multi-byte UTF-8 sequence of a printable character, C1 control characters are rejected as well.
+		 * @returns the length of the sequence or 0 if it is invalid
+		 */
+		[[nodiscard]] inline std::size_t utf8_sequence_length(std::span<const std::byte> bytes) noexcept
+		{
+			std::uint32_t code_point = 0;
+			const std::size_t length = decode_utf8_sequence(bytes, code_point);
+			return code_point >= 0xA0 ? length : 0;
+		}
+
+		// Control characters, surrogates, private use characters and noncharacters are not printable
+		[[nodiscard]] constexpr bool is_printable_unit(std::uint16_t unit) noexcept
+		{
+			if (unit < 0x80)
+				return is_printable(static_cast<std::uint8_t>(unit));
+			return unit >= 0xA0 && (unit < 0xD800 || unit > 0xF8FF) && unit < 0xFFFE;
+		}
+
+		inline void append_utf8(std::string& text, std::uint32_t code_point)
+		{
+			if (code_point < 0x80)
+				text += static_cast<char>(code_point);
+			else if (code_point < 0x800) {
+				text += static_cast<char>(0xC0 | (code_point >> 6));
+				text += static_cast<char>(0x80 | (code_point & 0x3F));
+			} else if (code_point < 0x10000) {
+				text += static_cast<char>(0xE0 | (code_point >> 12));
+				text += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+				text += static_cast<char>(0x80 | (code_point & 0x3F));
+			} else {
+				text += static_cast<char>(0xF0 | (code_point >> 18));
+				text += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+				text += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+				text += static_cast<char>(0x80 | (code_point & 0x3F));
+			}
+		}
+
+		// @returns the offset of the given character in valid UTF-8 text
+		[[nodiscard]] inline std::size_t utf8_offset(std::string_view text, std::size_t characters) noexcept
+		{
+			std::size_t offset = 0;
+			for (; offset < text.size(); offset++)
+				if ((static_cast<std::uint8_t>(text[offset]) & 0xC0) != 0x80 && characters-- == 0)
+					break;
+			return offset;
+		}
+
+		inline void extract_single_byte(std::span<const std::byte> data, std::uintptr_t base, const StringExtractionOptions& options, std::vector<FoundString>& results)
+		{
+			const bool utf8 = options.encodings & StringEncoding::UTF8;
+			const bool ascii = options.encodings & StringEncoding::ASCII;
+			if (!utf8 && !ascii)
+				return;
+
+			constexpr std::size_t NO_RUN = static_cast<std::size_t>(-1);
+			std::size_t run_start = NO_RUN;
+			std::size_t run_characters = 0;
+			bool multi_byte = false;
+
+			auto finish_run = [&](std::size_t end) {
+				if (run_start != NO_RUN && run_characters >= options.min_length) {
+					const auto* text = reinterpret_cast<const char*>(data.data() + run_start);
+					results.push_back(FoundString{
+						.address = base + run_start,
+						.encoding = multi_byte || !ascii ? StringEncoding::UTF8 : StringEncoding::ASCII,
+						.byte_length = end - run_start,
+						.text = std::string{ text, end - run_start },
+					});
+				}
+				run_start = NO_RUN;
+				run_characters = 0;
+				multi_byte = false;
+			};
+
+			std::size_t position = 0;
+			while (position < data.size()) {
+				if (position + BLOCK_SIZE <= data.size()) {
+					const std::byte* block = data.data() + position;
+					const std::uint32_t printable = printable_mask(block);
+					if (printable == FULL_BLOCK) {
+						if (run_start == NO_RUN)
+							run_start = position;
+						run_characters += BLOCK_SIZE;
+						position += BLOCK_SIZE;
+						continue;
+					}
+
+					const std::uint32_t candidates = utf8 ? printable | high_mask(block) : printable;
+					if (run_start == NO_RUN) {
+						// Skip straight to the first byte that could start a string
+						if (candidates == 0) {
+							position += BLOCK_SIZE;
+							continue;
+						}
+						position += std::countr_zero(candidates);
+					} else if (printable != 0 && (printable & 1) != 0) {
+						// Extend the current run by the printable prefix of the block
+						const auto prefix = static_cast<std::size_t>(std::countr_one(printable));
+						run_characters += prefix;
+						position += prefix;
+						continue;
+					}
+				}
+
+				const auto byte = static_cast<std::uint8_t>(data[position]);
+				if (is_printable(byte)) {
+					if (run_start == NO_RUN)
+						run_start = position;
+					run_characters++;
+					position++;
+					continue;
+				}
+
+				if (utf8 && byte >= 0x80) {
+					const std::size_t length = utf8_sequence_length(data.subspan(position));
+					if (length != 0) {
+						if (run_start == NO_RUN)
+							run_start = position;
+						run_characters++;
+						multi_byte = true;
+						position += length;
+						continue;
+					}
+				}
+
+				finish_run(position);
+				position++;
+			}
+			finish_run(data.size());
+		}
+
+		inline void extract_utf16le(std::span<const std::byte> data, std::uintptr_t base, const StringExtractionOptions& options, std::vector<FoundString>& results)
+		{
+			// Unless requested, only the ASCII subset of UTF-16 is considered, anything else yields too many false positives
+			const bool ascii_only = !options.utf16_beyond_ascii;
+			constexpr std::size_t NO_RUN = static_cast<std::size_t>(-1);
+			constexpr std::uint32_t ALL_UNITS = 0x5555;
+
+			for (std::size_t alignment = 0; alignment < 2; alignment++) {
+				std::size_t run_start = NO_RUN;
+				std::size_t run_characters = 0;
+
+				auto finish_run = [&](std::size_t end) {
+					if (run_start != NO_RUN && run_characters >= options.min_length) {
+						std::string text;
+						text.reserve(run_characters);
+						for (std::size_t i = run_start; i < end; i += 2)
+							append_utf8(text, static_cast<std::uint8_t>(data[i]) | static_cast<std::uint32_t>(data[i + 1]) << 8);
+						results.push_back(FoundString{
+							.address = base + run_start,
+							.encoding = StringEncoding::UTF16LE,
+							.byte_length = end - run_start,
+							.text = std::move(text),
+						});
+					}
+					run_start = NO_RUN;
+					run_characters = 0;
+				};
+
+				std::size_t position = alignment;
+				while (position + 1 < data.size()) {
+					if (position + BLOCK_SIZE <= data.size()) {
+						const std::byte* block = data.data() + position;
+						// A code unit is printable if its low byte is printable and its high byte is zero
+						const std::uint32_t units = printable_mask(block) & (zero_mask(block) >> 1) & ALL_UNITS;
+						if (units == ALL_UNITS) {
+							if (run_start == NO_RUN)
+								run_start = position;
+							run_characters += BLOCK_SIZE / 2;
+							position += BLOCK_SIZE;
+							continue;
+						}
+						if (units == 0 && run_start == NO_RUN && ascii_only) {
+							position += BLOCK_SIZE;
+							continue;
+						}
+					}
+
+					const auto unit = static_cast<std::uint16_t>(static_cast<std::uint8_t>(data[position]) | static_cast<std::uint8_t>(data[position + 1]) << 8);
+					if (ascii_only ? unit < 0x80 && is_printable(static_cast<std::uint8_t>(unit)) : is_printable_unit(unit)) {
+						if (run_start == NO_RUN)
+							run_start = position;
+						run_characters++;
+					} else
+						finish_run(position);
+					position += 2;
+				}
+				finish_run(position);
+			}
+		}
+
+		/**
+		 * Merges the pieces of runs that were split by chunk borders, the strings must be sorted by address.
+		 * Distinct runs of the same kind never overlap, so overlapping strings of the same kind are pieces of one run.
+		 */
+		inline void stitch(std::vector<FoundString>& strings)
+		{
+			constexpr std::size_t NONE = static_cast<std::size_t>(-1);
+			// Single byte runs, UTF-16 runs at even addresses and UTF-16 runs at odd addresses
+			std::array<std::size_t, 3> last{ NONE, NONE, NONE };
+
+			std::vector<FoundString> stitched;
+			stitched.reserve(strings.size());
+			for (FoundString& string : strings) {
+				const bool utf16 = string.encoding == StringEncoding::UTF16LE;
+				const std::size_t kind = utf16 ? 1 + string.address % 2 : 0;
+
+				if (last[kind] != NONE) {
+					FoundString& previous = stitched[last[kind]];
+					const std::uintptr_t previous_end = previous.address + previous.byte_length;
+					if (string.address < previous_end) {
+						const std::uintptr_t end = string.address + string.byte_length;
+						if (end > previous_end) {
+							// UTF-16 text has been converted, so the covered code units have to be counted in characters
+							const std::size_t covered = previous_end - string.address;
+							previous.text += string.text.substr(utf16 ? utf8_offset(string.text, covered / 2) : covered);
+							previous.byte_length = end - previous.address;
+						}
+						if (string.encoding == StringEncoding::UTF8)
+							previous.encoding = StringEncoding::UTF8;
+						continue;
+					}
+				}
+
+				last[kind] = stitched.size();
+				stitched.push_back(std::move(string));
+			}
+			strings = std::move(stitched);
+		}
+
+		[[nodiscard]] inline std::vector<std::byte> encode_utf16le(std::string_view utf8)
+		{
+			std::vector<std::byte> bytes;
+			bytes.reserve(utf8.size() * 2);
+
+			auto push_unit = [&bytes](std::uint32_t unit) {
+				bytes.push_back(static_cast<std::byte>(unit & 0xFF));
+				bytes.push_back(static_cast<std::byte>(unit >> 8));
+			};
+
+			const std::span input{ reinterpret_cast<const std::byte*>(utf8.data()), utf8.size() };
+			for (std::size_t i = 0; i < input.size();) {
+				const auto lead = static_cast<std::uint8_t>(input[i]);
+				if (lead < 0x80) {
+					push_unit(lead);
+					i++;
+					continue;
+				}
+
+				// Needles may contain any character, control characters included
+				std::uint32_t code_point = 0;
+				const std::size_t length = decode_utf8_sequence(input.subspan(i), code_point);
+				if (length == 0)
+					throw std::invalid_argument{ "Needle is not valid UTF-8" };
+				i += length;
+
+				if (code_point >= 0x10000) {
+					code_point -= 0x10000;
+					push_unit(0xD800 | (code_point >> 10));
+					push_unit(0xDC00 | (code_point & 0x3FF));
+				} else
+					push_unit(code_point);
+			}
+			return bytes;
+		}
+	}
+
+	/**
+	 * Finds all printable runs in a block of memory.
+	 * @param base the address of the first byte of data in the target
+	 */
+	inline void extract_strings(std::span<const std::byte> data, std::uintptr_t base, const StringExtractionOptions& options, std::vector<FoundString>& results)
+	{
+		const std::size_t first = results.size();
+		if ((options.encodings & StringEncoding::ASCII) || (options.encodings & StringEncoding::UTF8))
+			Strings::extract_single_byte(data, base, options, results);
+		if (options.encodings & StringEncoding::UTF16LE)
+			Strings::extract_utf16le(data, base, options, results);
+		std::ranges::sort(results.begin() + static_cast<std::ptrdiff_t>(first), results.end(), {}, &FoundString::address);
+	}
+
+	/**
+	 * Finds all printable runs in the selected regions of a memory manager, large regions are split into chunks.
+	 * Runs that cross the end of a chunk are seen by both chunks and stitched back together.
+	 * @returns the strings, sorted by address
+	 */
+	template <typename MemMgr>
+		requires Traversable<MemMgr>
+	[[nodiscard]] std::vector<FoundString> extract_strings(const MemMgr& manager, const StringExtractionOptions& options = {}, typename RegionTraversal<MemMgr>::Options traversal_options = {})
+	{
+		// The overlap must be large enough for the piece in front of a chunk border to be reported on its own
+		constexpr std::size_t MIN_OVERLAP = 4096;
+		traversal_options.overlap = std::max({ traversal_options.overlap, MIN_OVERLAP, options.min_length * 4 });
+
+		const RegionTraversal<MemMgr> traversal{ manager, std::move(traversal_options) };
+		const std::size_t chunk_size = traversal.get_chunk_size();
+
+		std::vector<FoundString> results;
+		std::mutex results_mutex;
+		traversal.run([&](std::uintptr_t address, std::span<const std::byte> bytes) {
+			std::vector<FoundString> strings;
+			extract_strings(bytes, address, options, strings);
+			// Runs that begin in the overlap are reported by the next chunk
+			std::erase_if(strings, [&](const FoundString& string) { return string.address - address >= chunk_size; });
+
+			const std::scoped_lock lock{ results_mutex };
+			std::ranges::move(strings, std::back_inserter(results));
+		});
+
+		std::ranges::sort(results, {}, &FoundString::address);
+		Strings::stitch(results);
+		return results;
+	}
+
+	/**
+	 * Searches for many needles at once using an Aho-Corasick automaton.
+	 * The automaton is compiled into a full transition table, so matching costs one lookup per byte.
+	 * While no partial match is in progress, bytes that can't start any needle are skipped in bulk.
+	 */
+	class NeedleSearcher {
+		static constexpr std::uint32_t ROOT = 0;
+
+		std::vector<std::vector<std::byte>> needles;
+
+		bool compiled = false;
+		std::vector<std::array<std::uint32_t, 256>> transitions;
+		// Needles that end in a state, including the ones reachable through suffix links
+		std::vector<std::vector<std::size_t>> outputs;
+		std::array<bool, 256> starts{};
+		std::vector<std::uint8_t> distinct_starts;
+
+		void compile()
+		{
+			transitions.assign(1, {});
+			outputs.assign(1, {});
+			starts = {};
+			distinct_starts.clear();
+
+			// Build the trie, 0 marks missing edges since the root is never a child
+			for (std::size_t index = 0; index < needles.size(); index++) {
+				std::uint32_t state = ROOT;
+				for (const std::byte byte : needles[index]) {
+					const auto edge = static_cast<std::uint8_t>(byte);
+					if (transitions[state][edge] == ROOT) {
+						// Growing the table invalidates references into it
+						const auto child = static_cast<std::uint32_t>(transitions.size());
+						transitions.emplace_back();
+						outputs.emplace_back();
+						transitions[state][edge] = child;
+					}
+					state = transitions[state][edge];
+				}
+				outputs[state].push_back(index);
+
+				const auto first = static_cast<std::uint8_t>(needles[index].front());
+				if (!starts[first]) {
+					starts[first] = true;
+					distinct_starts.push_back(first);
+				}
+			}
+
+			// Breadth first traversal turns the trie into a DFA
+			std::vector<std::uint32_t> failure(transitions.size(), ROOT);
+			std::deque<std::uint32_t> queue;
+			for (const std::uint32_t child : transitions[ROOT])
+				if (child != ROOT)
+					queue.push_back(child);
+
+			while (!queue.empty()) {
+				const std::uint32_t state = queue.front();
+				queue.pop_front();
+
+				const auto& inherited = outputs[failure[state]];
+				outputs[state].insert(outputs[state].end(), inherited.begin(), inherited.end());
+
+				for (std::size_t byte = 0; byte < 256; byte++) {
+					std::uint32_t& next = transitions[state][byte];
+					if (next == ROOT)
+						next = transitions[failure[state]][byte];
+					else {
+						failure[next] = transitions[failure[state]][byte];
+						queue.push_back(next);
+					}
+				}
+			}
+
+			compiled = true;
+		}
+
+		[[nodiscard]] std::size_t skip_to_start(std::span<const std::byte> data, std::size_t position) const noexcept
+		{
+#ifdef __SSE2__
+			if (distinct_starts.size() <= 4) {
+				// Unused probes repeat the last start byte
+				auto probe = [this](std::size_t i) {
+					return _mm_set1_epi8(static_cast<char>(distinct_starts[std::min(i, distinct_starts.size() - 1)]));
+				};
+				const __m128i probe0 = probe(0);
+				const __m128i probe1 = probe(1);
+				const __m128i probe2 = probe(2);
+				const __m128i probe3 = probe(3);
+
+				for (; position + Strings::BLOCK_SIZE <= data.size(); position += Strings::BLOCK_SIZE) {
+					const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data.data() + position));
+					const __m128i hits = _mm_or_si128(
+						_mm_or_si128(_mm_cmpeq_epi8(bytes, probe0), _mm_cmpeq_epi8(bytes, probe1)),
+						_mm_or_si128(_mm_cmpeq_epi8(bytes, probe2), _mm_cmpeq_epi8(bytes, probe3)));
+					const int mask = _mm_movemask_epi8(hits);
+					if (mask != 0)
+						return position + std::countr_zero(static_cast<std::uint32_t>(mask));
+				}
+			}
+#endif
+			while (position < data.size() && !starts[static_cast<std::uint8_t>(data[position])])
+				position++;
+			return position;
+		}
+
+	public:
+		/**
+		 * @returns the index of the needle, which is reported in matches
+		 */
+		std::size_t add_needle(std::span<const std::byte> needle)
+		{
+			if (needle.empty())
+				throw std::invalid_argument{ "Needles must not be empty" };
+			needles.emplace_back(needle.begin(), needle.end());
+			compiled = false;
+			return needles.size() - 1;
+		}
+
+		/**
+		 * @param text UTF-8 encoded text
+		 * @param encoding the encoding the text is searched in, must be a single encoding
+		 */
+		std::size_t add_string(std::string_view text, StringEncoding encoding = StringEncoding::UTF8)
+		{
+			switch (encoding) {
+			case StringEncoding::ASCII:
+			case StringEncoding::UTF8:
+				return add_needle(std::span{ reinterpret_cast<const std::byte*>(text.data()), text.size() });
+			case StringEncoding::UTF16LE:
+				return add_needle(Strings::encode_utf16le(text));
+			default:
+				throw std::invalid_argument{ "Needles must be added once per encoding" };
+			}
+		}
+
+		[[nodiscard]] std::span<const std::byte> get_needle(std::size_t index) const
+		{
+			return needles.at(index);
+		}
+
+		[[nodiscard]] std::size_t size() const noexcept
+		{
+			return needles.size();
+		}
+
+		// Compiles the automaton ahead of time, searching does this on demand
+		void prepare()
+		{
+			if (!compiled)
+				compile();
+		}
+
+		/**
+		 * Reports every occurrence of every needle, overlapping occurrences included.
+		 * @param base the address of the first byte of data in the target
+		 */
+		void search(std::span<const std::byte> data, std::uintptr_t base, std::vector<NeedleMatch>& results)
+		{
+			prepare();
+			std::as_const(*this).search_prepared(data, base, results);
+		}
+
+		// Same as search, but usable from multiple threads at once after prepare() has been called
+		void search_prepared(std::span<const std::byte> data, std::uintptr_t base, std::vector<NeedleMatch>& results) const
+		{
+			if (!compiled)
+				throw std::logic_error{ "NeedleSearcher has not been prepared" };
+			if (needles.empty())
+				return;
+
+			std::uint32_t state = ROOT;
+			for (std::size_t position = 0; position < data.size(); position++) {
+				if (state == ROOT) {
+					position = skip_to_start(data, position);
+					if (position >= data.size())
+						break;
+				}
+
+				state = transitions[state][static_cast<std::uint8_t>(data[position])];
+				for (const std::size_t needle : outputs[state])
+					results.push_back(NeedleMatch{
+						.address = base + position + 1 - needles[needle].size(),
+						.needle = needle,
+					});
+			}
+		}
+
+		/**
+		 * Searches the selected regions of a memory manager.
+		 * Chunks overlap by the length of the longest needle, so only occurrences that span multiple regions are missed.
+		 * @returns the matches, sorted by address
+		 */
+		template <typename MemMgr>
+			requires Traversable<MemMgr>
+		[[nodiscard]] std::vector<NeedleMatch> search(const MemMgr& manager, typename RegionTraversal<MemMgr>::Options traversal_options = {})
+		{
+			prepare();
+
+			std::size_t longest = 0;
+			for (const auto& needle : needles)
+				longest = std::max(longest, needle.size());
+			traversal_options.overlap = longest == 0 ? 0 : longest - 1;
+
+			const RegionTraversal<MemMgr> traversal{ manager, std::move(traversal_options) };
+			const std::size_t chunk_size = traversal.get_chunk_size();
+
+			std::vector<NeedleMatch> results;
+			std::mutex results_mutex;
+			traversal.run([&](std::uintptr_t address, std::span<const std::byte> bytes) {
+				std::vector<NeedleMatch> matches;
+				search_prepared(bytes, address, matches);
+				// Occurrences that begin in the overlap are reported by the next chunk
+				std::erase_if(matches, [&](const NeedleMatch& match) { return match.address - address >= chunk_size; });
+
+				const std::scoped_lock lock{ results_mutex };
+				std::ranges::move(matches, std::back_inserter(results));
+			});
+
+			std::ranges::sort(results, {}, &NeedleMatch::address);
+			return results;
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,340 @@
+#ifndef MEMORYMANAGER_WATCHLIST_HPP
+#define MEMORYMANAGER_WATCHLIST_HPP
+
+#include "MemoryManager/MemoryManager.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace MemoryManager {
+	/**
+	 * Polls a set of watched addresses and reports the ones whose contents changed.
+	 *
+	 * Watches are grouped by their page (or any other granularity passed to the constructor),
+	 * every group is fetched with a single read and compared against the previous poll as a whole.
+	 * Only when a group differs are its members compared individually.
+	 */
+	template <typename MemMgr>
+		requires Reader<MemMgr>
+	class WatchList {
+	public:
+		using WatchId = std::size_t;
+		using Clock = std::chrono::steady_clock;
+
+		struct Change {
+			WatchId id;
+			std::uintptr_t address;
+			// Both spans are only valid until the next poll
+			std::span<const std::byte> previous;
+			std::span<const std::byte> current;
+		};
+
+		using Callback = std::function<void(const Change&)>;
+
+	private:
+		struct Watch {
+			std::uintptr_t address;
+			std::size_t size;
+			Callback callback;
+			bool active;
+			bool primed;
+		};
+
+		struct Group {
+			std::uintptr_t address;
+			std::size_t length;
+			std::size_t image_offset;
+			std::size_t first_member;
+			std::size_t member_count;
+			bool needs_priming;
+		};
+
+		const MemMgr* manager;
+		std::size_t granularity;
+
+		std::vector<Watch> watches;
+		std::vector<WatchId> free_ids;
+
+		bool dirty = false;
+		std::vector<Group> groups;
+		std::vector<WatchId> members;
+		std::vector<std::byte> current_image;
+		std::vector<std::byte> previous_image;
+
+		std::vector<Change> changes;
+		// Owns the bytes the changes point to, so rebuilding the images doesn't invalidate them
+		std::vector<std::byte> change_bytes;
+		bool dispatching = false;
+
+		Clock::duration interval{};
+		Clock::time_point last_poll{};
+
+		static std::size_t default_granularity(const MemMgr& manager)
+		{
+			if constexpr (GranularityAware<MemMgr>)
+				return manager.get_page_granularity();
+			else
+				return 4096;
+		}
+
+		void rebuild()
+		{
+			std::vector<WatchId> sorted;
+			sorted.reserve(watches.size() - free_ids.size());
+			for (WatchId id = 0; id < watches.size(); id++)
+				if (watches[id].active)
+					sorted.push_back(id);
+			std::ranges::sort(sorted, {}, [this](WatchId id) { return watches[id].address; });
+
+			std::vector<Group> new_groups;
+			for (std::size_t i = 0; i < sorted.size(); i++) {
+				const Watch& watch = watches[sorted[i]];
+				const std::uintptr_t end = watch.address + watch.size;
+
+				if (!new_groups.empty()) {
+					Group& group = new_groups.back();
+					if (watch.address / granularity == group.address / granularity) {
+						group.length = std::max(group.length, end - group.address);
+						group.member_count++;
+						group.needs_priming |= !watch.primed;
+						continue;
+					}
+				}
+
+				new_groups.push_back(Group{
+					.address = watch.address,
+					.length = watch.size,
+					.image_offset = 0,
+					.first_member = i,
+					.member_count = 1,
+					.needs_priming = !watch.primed,
+				});
+			}
+
+			std::size_t image_size = 0;
+			for (Group& group : new_groups) {
+				group.image_offset = image_size;
+				image_size += group.length;
+			}
+
+			// Carry over the last known values, the bytes in between watches are irrelevant
+			std::vector<std::byte> new_previous(image_size);
+			for (const Group& group : new_groups)
+				for (std::size_t i = group.first_member; i < group.first_member + group.member_count; i++) {
+					const Watch& watch = watches[sorted[i]];
+					if (!watch.primed)
+						continue;
+					const auto old_offset = locate(watch.address);
+					std::memcpy(new_previous.data() + group.image_offset + (watch.address - group.address),
+						previous_image.data() + old_offset, watch.size);
+				}
+
+			groups = std::move(new_groups);
+			members = std::move(sorted);
+			previous_image = std::move(new_previous);
+			current_image.assign(image_size, std::byte{});
+			dirty = false;
+		}
+
+		// Finds the offset of a primed watch in the image of the current grouping
+		[[nodiscard]] std::size_t locate(std::uintptr_t address) const
+		{
+			auto it = std::ranges::upper_bound(groups, address, {}, &Group::address);
+			// Primed watches always belong to a group
+			it--;
+			return it->image_offset + (address - it->address);
+		}
+
+	public:
+		explicit WatchList(const MemMgr& manager)
+			: WatchList(manager, default_granularity(manager))
+		{
+		}
+
+		WatchList(const MemMgr& manager, std::size_t granularity)
+			: manager(&manager)
+			, granularity(granularity)
+		{
+			if (granularity == 0)
+				throw std::invalid_argument{ "Granularity must not be zero" };
+		}
+
+		WatchId add(std::uintptr_t address, std::size_t size, Callback callback = {})
+		{
+			if (size == 0)
+				throw std::invalid_argument{ "Watches must cover at least one byte" };
+
+			Watch watch{
+				.address = address,
+				.size = size,
+				.callback = std::move(callback),
+				.active = true,
+				.primed = false,
+			};
+
+			dirty = true;
+
+			if (!free_ids.empty()) {
+				const WatchId id = free_ids.back();
+				free_ids.pop_back();
+				watches[id] = std::move(watch);
+				return id;
+			}
+
+			watches.push_back(std::move(watch));
+			return watches.size() - 1;
+		}
+
+		template <typename T>
+			requires std::is_trivially_copyable_v<T>
+		WatchId add(std::uintptr_t address, Callback callback = {})
+		{
+			return add(address, sizeof(T), std::move(callback));
+		}
+
+		void remove(WatchId id)
+		{
+			if (id >= watches.size() || !watches[id].active)
+				throw std::out_of_range{ "Unknown watch" };
+
+			watches[id].active = false;
+			watches[id].callback = {};
+			free_ids.push_back(id);
+			dirty = true;
+		}
+
+		void clear()
+		{
+			watches.clear();
+			free_ids.clear();
+			dirty = true;
+		}
+
+		[[nodiscard]] std::size_t size() const noexcept
+		{
+			return watches.size() - free_ids.size();
+		}
+
+		// Returns the number of reads that are issued per poll
+		[[nodiscard]] std::size_t get_group_count()
+		{
+			if (dirty)
+				rebuild();
+			return groups.size();
+		}
+
+		void set_interval(Clock::duration new_interval) noexcept
+		{
+			interval = new_interval;
+		}
+
+		[[nodiscard]] Clock::duration get_interval() const noexcept
+		{
+			return interval;
+		}
+
+		/**
+		 * Reads all watched memory and compares it to the previous poll.
+		 * Newly added watches don't report changes on their first poll, since there is nothing to compare to.
+		 * Callbacks are invoked after all groups have been read, they may add and remove watches but not poll.
+		 * If a read throws, the poll has no effect.
+		 * @returns the changes of this poll, the reference is valid until the next poll
+		 */
+		const std::vector<Change>& poll()
+		{
+			if (dispatching)
+				throw std::logic_error{ "Callbacks must not poll their own watch list" };
+
+			if (dirty)
+				rebuild();
+
+			changes.clear();
+			change_bytes.clear();
+
+			// All reads happen before any state is touched, so a failing read leaves the list as it was
+			for (const Group& group : groups)
+				manager->read(group.address, current_image.data() + group.image_offset, group.length);
+
+			for (Group& group : groups) {
+				const std::byte* current = current_image.data() + group.image_offset;
+				const std::byte* previous = previous_image.data() + group.image_offset;
+
+				if (!group.needs_priming && std::memcmp(current, previous, group.length) == 0)
+					continue;
+				group.needs_priming = false;
+
+				for (std::size_t i = group.first_member; i < group.first_member + group.member_count; i++) {
+					const WatchId id = members[i];
+					Watch& watch = watches[id];
+					const std::size_t offset = watch.address - group.address;
+
+					if (!watch.primed) {
+						watch.primed = true;
+						continue;
+					}
+
+					if (std::memcmp(current + offset, previous + offset, watch.size) == 0)
+						continue;
+
+					// The spans are pointed at their copies once all changes are known
+					changes.push_back(Change{ .id = id, .address = watch.address, .previous = {}, .current = {} });
+					change_bytes.insert(change_bytes.end(), previous + offset, previous + offset + watch.size);
+					change_bytes.insert(change_bytes.end(), current + offset, current + offset + watch.size);
+				}
+			}
+
+			std::size_t change_offset = 0;
+			for (Change& change : changes) {
+				const std::size_t size = watches[change.id].size;
+				change.previous = std::span{ change_bytes.data() + change_offset, size };
+				change.current = std::span{ change_bytes.data() + change_offset + size, size };
+				change_offset += size * 2;
+			}
+
+			std::swap(current_image, previous_image);
+			last_poll = Clock::now();
+
+			// Callbacks may add or remove watches, which would invalidate or destroy them while they are running
+			std::vector<Callback> callbacks;
+			callbacks.reserve(changes.size());
+			for (const Change& change : changes)
+				callbacks.push_back(watches[change.id].callback);
+
+			dispatching = true;
+			try {
+				for (std::size_t i = 0; i < changes.size(); i++)
+					if (callbacks[i])
+						callbacks[i](changes[i]);
+			} catch (...) {
+				dispatching = false;
+				throw;
+			}
+			dispatching = false;
+
+			return changes;
+		}
+
+		/**
+		 * Polls if at least the configured interval has passed since the previous poll.
+		 * @returns true if a poll has happened
+		 */
+		bool poll_if_due(Clock::time_point now = Clock::now())
+		{
+			if (now - last_poll < interval)
+				return false;
+			poll();
+			return true;
+		}
+	};
+}
+
+#endif
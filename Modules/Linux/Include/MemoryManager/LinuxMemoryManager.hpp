@@ -3,7 +3,9 @@
 
 #include "MemoryManager/MemoryManager.hpp"
 
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <cerrno>
 #include <cstddef>
 #include <cstdint>
@@ -23,6 +25,7 @@
 #include <unistd.h>
 #include <utility>
 #include <variant>
+#include <vector>
 
 namespace MemoryManager {
 	template <bool Read, bool Write, bool Local>
@@ -30,6 +33,7 @@ namespace MemoryManager {
 
 	struct LinuxNamedData {
 		std::string name; // may be a path
+		std::size_t file_offset = 0;
 
 		bool deleted = false;
 		bool special = false;
@@ -41,6 +45,81 @@ namespace MemoryManager {
 		PRIVATE,
 	};
 
+	enum class LinuxResidencyPolicy : std::uint8_t {
+		PRESENT, // only pages that are currently in physical memory
+		PRESENT_OR_SWAPPED, // also pages that have been written, but are swapped out
+	};
+
+	// One bit per page of an address range, indicating if the page is backed by memory
+	class LinuxPagePresence {
+		std::uintptr_t address;
+		std::size_t page_size;
+		std::size_t page_count;
+		std::vector<std::uint64_t> bits;
+
+	public:
+		LinuxPagePresence(std::uintptr_t address, std::size_t page_size, std::size_t page_count)
+			: address(address)
+			, page_size(page_size)
+			, page_count(page_count)
+			, bits((page_count + 63) / 64)
+		{
+		}
+
+		[[nodiscard]] std::uintptr_t get_address() const noexcept
+		{
+			return address;
+		}
+
+		[[nodiscard]] std::size_t get_page_size() const noexcept
+		{
+			return page_size;
+		}
+
+		[[nodiscard]] std::size_t get_page_count() const noexcept
+		{
+			return page_count;
+		}
+
+		[[nodiscard]] bool is_present(std::size_t page) const noexcept
+		{
+			return (bits[page / 64] >> (page % 64) & 1) != 0;
+		}
+
+		void set_present(std::size_t page, bool present) noexcept
+		{
+			if (present)
+				bits[page / 64] |= std::uint64_t{ 1 } << (page % 64);
+			else
+				bits[page / 64] &= ~(std::uint64_t{ 1 } << (page % 64));
+		}
+
+		[[nodiscard]] std::size_t get_present_count() const noexcept
+		{
+			std::size_t count = 0;
+			for (const std::uint64_t word : bits)
+				count += std::popcount(word);
+			return count;
+		}
+
+		// Invokes callback(address, length) for every run of consecutive present pages
+		template <typename Callback>
+		void for_each_run(Callback&& callback) const
+		{
+			for (std::size_t page = 0; page < page_count;) {
+				if (!is_present(page)) {
+					page++;
+					continue;
+				}
+				std::size_t end = page + 1;
+				while (end < page_count && is_present(end))
+					end++;
+				callback(address + page * page_size, (end - page) * page_size);
+				page = end;
+			}
+		}
+	};
+
 	template <typename MemMgr, bool CanRead, bool Local>
 	class LinuxRegion {
 		const MemMgr* parent;
@@ -112,6 +191,11 @@ namespace MemoryManager {
 			});
 		}
 
+		[[nodiscard]] std::size_t get_offset() const noexcept
+		{
+			return named_data.has_value() ? named_data->file_offset : 0;
+		}
+
 		[[nodiscard]] bool is_deleted() const noexcept
 		{
 			return named_data.has_value() && named_data->deleted;
@@ -144,6 +228,71 @@ namespace MemoryManager {
 
 			return std::span{ cached_memory.get(), get_length() };
 		}
+
+		/**
+		 * Queries which pages of this region are backed by memory, without faulting any of them in.
+		 * In private anonymous regions, pages that are neither present nor swapped out have never been written and read as zeros.
+		 */
+		[[nodiscard]] LinuxPagePresence get_page_presence(LinuxResidencyPolicy policy = LinuxResidencyPolicy::PRESENT) const
+		{
+			return parent->query_page_presence(get_address(), get_length(), policy);
+		}
+
+		/**
+		 * Indicates if this region is private memory that isn't backed by a file.
+		 * Only in such regions, pages that are not backed by memory are known to read as zeros.
+		 */
+		[[nodiscard]] bool is_private_anonymous() const noexcept
+		{
+			if (shared_state != LinuxSharedState::PRIVATE)
+				return false;
+			if (!named_data.has_value())
+				return true;
+			const std::string& name = named_data->name;
+			return name == "[heap]" || name.starts_with("[stack") || name.starts_with("[anon:");
+		}
+
+		/**
+		 * Invokes callback(address, span) for all data of this region that may be nonzero, in ascending order.
+		 * In private anonymous regions, runs of pages that are not backed by memory are skipped without touching
+		 * (and therefore allocating) them. Note that PRESENT also skips pages that have been swapped out.
+		 * Pages of all other regions hold file or shared memory contents even if they aren't resident, so they are
+		 * always passed on.
+		 * Copied runs are passed in pieces of bounded size, the spans are only valid during the callback.
+		 */
+		template <typename Callback>
+		void for_each_resident_span(Callback&& callback, LinuxResidencyPolicy policy = LinuxResidencyPolicy::PRESENT) const
+			requires CanRead
+		{
+			constexpr std::size_t MAX_READ_LENGTH = std::size_t{ 1 } << 20;
+
+			std::unique_ptr<std::byte[]> buffer;
+			std::size_t buffer_length = 0;
+			auto visit = [&](std::uintptr_t run_address, std::size_t run_length) {
+				run_length = std::min(run_length, get_address() + get_length() - run_address);
+
+				if constexpr (Local)
+					if (does_update_view()) {
+						callback(run_address, std::span{ reinterpret_cast<const std::byte*>(run_address), run_length });
+						return;
+					}
+
+				for (std::size_t offset = 0; offset < run_length; offset += MAX_READ_LENGTH) {
+					const std::size_t length = std::min(MAX_READ_LENGTH, run_length - offset);
+					if (buffer_length < length) {
+						buffer.reset(new std::byte[length]);
+						buffer_length = length;
+					}
+					parent->read(run_address + offset, buffer.get(), length);
+					callback(run_address + offset, std::span<const std::byte>{ buffer.get(), length });
+				}
+			};
+
+			if (is_private_anonymous())
+				get_page_presence(policy).for_each_run(visit);
+			else
+				visit(get_address(), get_length());
+		}
 	};
 
 	template <bool Read, bool Write, bool Local = false>
@@ -191,6 +340,31 @@ namespace MemoryManager {
 			}
 		}
 
+		static constexpr std::uint64_t PRESENT_BIT = std::uint64_t{ 1 } << 63;
+		static constexpr std::uint64_t SWAPPED_BIT = std::uint64_t{ 1 } << 62;
+		static constexpr std::uint64_t SOFT_DIRTY_BIT = std::uint64_t{ 1 } << 55;
+
+		// Sets the bit of every page whose pagemap entry has any of the bits in mask, entries that couldn't be read are left cleared
+		static void read_pagemap(int pagemap, std::uint64_t mask, LinuxPagePresence& pages)
+		{
+			const std::size_t page_size = pages.get_page_size();
+			const std::size_t page_count = pages.get_page_count();
+
+			constexpr std::size_t ENTRIES_PER_READ = 4096;
+			std::vector<std::uint64_t> entries(std::min(ENTRIES_PER_READ, page_count));
+			for (std::size_t page = 0; page < page_count; page += entries.size()) {
+				const std::size_t count = std::min(entries.size(), page_count - page);
+				const auto offset = static_cast<off_t>((pages.get_address() / page_size + page) * sizeof(std::uint64_t));
+				const auto res = pread(pagemap, entries.data(), count * sizeof(std::uint64_t), offset);
+				if (res == -1)
+					throw std::runtime_error(strerror(errno));
+
+				const std::size_t read_entries = static_cast<std::size_t>(res) / sizeof(std::uint64_t);
+				for (std::size_t i = 0; i < read_entries; i++)
+					pages.set_present(page + i, (entries[i] & mask) != 0);
+			}
+		}
+
 		static constexpr int flags_to_posix(Flags flags) noexcept
 		{
 			int prot = 0;
@@ -279,6 +453,7 @@ namespace MemoryManager {
 
 				std::uintptr_t begin = 0;
 				std::uintptr_t end = 0;
+				std::size_t file_offset = 0;
 				std::array<char, 3> perms{};
 				char shared = 0;
 				std::string name;
@@ -286,8 +461,8 @@ namespace MemoryManager {
 				int offset = -1;
 
 				// NOLINTNEXTLINE(cert-err34-c)
-				(void)sscanf(line.c_str(), "%zx-%zx %c%c%c%c %*x %*x:%*x %*x%n",
-					&begin, &end, &perms[0], &perms[1], &perms[2], &shared, &offset);
+				(void)sscanf(line.c_str(), "%zx-%zx %c%c%c%c %zx %*x:%*x %*x%n",
+					&begin, &end, &perms[0], &perms[1], &perms[2], &shared, &file_offset, &offset);
 
 				while (std::cmp_less(offset, line.length()) && line[offset] == ' ')
 					offset++;
@@ -308,7 +483,9 @@ namespace MemoryManager {
 
 					if (name[0] == '[') {
 						special = true;
-						flags.set_readable(false); // They technically are, but only under a lot of conditions
+						// The heap, stacks and named anonymous memory are plain memory
+						if (name != "[heap]" && !name.starts_with("[stack") && !name.starts_with("[anon:"))
+							flags.set_readable(false); // They technically are, but only under a lot of conditions
 					}
 				}
 
@@ -328,7 +505,7 @@ namespace MemoryManager {
 				}
 
 				new_layout.emplace(this, begin, end - begin, flags, shared_state,
-					name.empty() ? std::nullopt : std::make_optional(LinuxNamedData{ .name = name, .deleted = deleted, .special = special }));
+					name.empty() ? std::nullopt : std::make_optional(LinuxNamedData{ .name = name, .file_offset = file_offset, .deleted = deleted, .special = special }));
 			}
 
 			file_stream.close();
@@ -343,6 +520,107 @@ namespace MemoryManager {
 			return CACHED_PAGE_SIZE;
 		}
 
+		/**
+		 * Determines which pages of an address range are backed by memory using /proc/[pid]/pagemap.
+		 * Local managers fall back to mincore if the pagemap can't be opened, which can't tell swapped pages apart.
+		 * @param address must be aligned to page granularity
+		 */
+		[[nodiscard]] LinuxPagePresence query_page_presence(std::uintptr_t address, std::size_t length, LinuxResidencyPolicy policy) const
+		{
+			const std::size_t page_size = get_page_granularity();
+			const std::size_t page_count = (length + page_size - 1) / page_size;
+			LinuxPagePresence presence{ address, page_size, page_count };
+
+			const int pagemap = ::open(("/proc/" + pid + "/pagemap").c_str(), O_RDONLY);
+			if (pagemap == -1) {
+				if constexpr (Local) {
+					std::vector<unsigned char> residency(page_count);
+					if (mincore(reinterpret_cast<void*>(address), length, residency.data()) == -1)
+						throw std::runtime_error(strerror(errno));
+					for (std::size_t page = 0; page < page_count; page++)
+						presence.set_present(page, (residency[page] & 1) != 0);
+					return presence;
+				}
+				throw std::runtime_error(strerror(errno));
+			}
+
+			const std::uint64_t mask = policy == LinuxResidencyPolicy::PRESENT ? PRESENT_BIT : PRESENT_BIT | SWAPPED_BIT;
+			try {
+				read_pagemap(pagemap, mask, presence);
+			} catch (...) {
+				::close(pagemap);
+				throw;
+			}
+			::close(pagemap);
+			return presence;
+		}
+
+		/**
+		 * Indicates if the kernel tracks soft-dirty bits (CONFIG_MEM_SOFT_DIRTY), which is probed once on a page of this process.
+		 * Kernels without it accept clear_dirty_pages, but never report a page as dirty.
+		 */
+		[[nodiscard]] static bool supports_dirty_tracking()
+		{
+			static const bool SUPPORTED = [] {
+				const auto page_size = static_cast<std::size_t>(getpagesize());
+				void* page = mmap(nullptr, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (page == MAP_FAILED)
+					return false;
+				// Pages are soft-dirty after they have been written for the first time
+				*static_cast<volatile char*>(page) = 1;
+
+				std::uint64_t entry = 0;
+				const int pagemap = ::open("/proc/self/pagemap", O_RDONLY);
+				const auto offset = static_cast<off_t>(reinterpret_cast<std::uintptr_t>(page) / page_size * sizeof(entry));
+				const bool read = pagemap != -1 && pread(pagemap, &entry, sizeof(entry), offset) == sizeof(entry);
+				if (pagemap != -1)
+					::close(pagemap);
+				munmap(page, page_size);
+				return read && (entry & SOFT_DIRTY_BIT) != 0;
+			}();
+			return SUPPORTED;
+		}
+
+		/**
+		 * Determines which pages of an address range have been written since the last call to clear_dirty_pages,
+		 * using the soft-dirty bits of /proc/[pid]/pagemap. Pages of mappings that were created since then count as written.
+		 * @param address must be aligned to page granularity
+		 */
+		[[nodiscard]] LinuxPagePresence query_dirty_pages(std::uintptr_t address, std::size_t length) const
+		{
+			const std::size_t page_size = get_page_granularity();
+			LinuxPagePresence dirty{ address, page_size, (length + page_size - 1) / page_size };
+
+			const int pagemap = ::open(("/proc/" + pid + "/pagemap").c_str(), O_RDONLY);
+			if (pagemap == -1)
+				throw std::runtime_error(strerror(errno));
+			try {
+				read_pagemap(pagemap, SOFT_DIRTY_BIT, dirty);
+			} catch (...) {
+				::close(pagemap);
+				throw;
+			}
+			::close(pagemap);
+			return dirty;
+		}
+
+		/**
+		 * Clears the soft-dirty bits of every page of the process, by writing to /proc/[pid]/clear_refs.
+		 * This affects everyone who tracks the process this way. Writes that happen while the bits are being queried and
+		 * cleared may be missed, unless the process is stopped.
+		 */
+		void clear_dirty_pages() const
+		{
+			const int clear_refs = ::open(("/proc/" + pid + "/clear_refs").c_str(), O_WRONLY);
+			if (clear_refs == -1)
+				throw std::runtime_error(strerror(errno));
+			const auto res = ::write(clear_refs, "4", 1);
+			const int err = errno;
+			::close(clear_refs);
+			if (res != 1)
+				throw std::runtime_error(strerror(err));
+		}
+
 		[[nodiscard]] std::uintptr_t allocate(std::size_t size, Flags protection) const
 			requires Local
 		{
@@ -397,18 +675,17 @@ namespace MemoryManager {
 		{
 			if constexpr (Local && !Read) {
 				std::memcpy(content, reinterpret_cast<void*>(address), length);
-				return;
-			}
-
-			ensure_open();
+			} else {
+				ensure_open();
 
 #ifdef __GLIBC__
-			const auto res = pread64(mem_interface, content, length, static_cast<off64_t>(address));
+				const auto res = pread64(mem_interface, content, length, static_cast<off64_t>(address));
 #else
-			const auto res = pread(mem_interface, content, length, static_cast<off_t>(address));
+				const auto res = pread(mem_interface, content, length, static_cast<off_t>(address));
 #endif
-			if (res == -1)
-				throw std::runtime_error(strerror(errno));
+				if (res == -1)
+					throw std::runtime_error(strerror(errno));
+			}
 		}
 
 		void write(std::uintptr_t address, const void* content, std::size_t length) const
@@ -416,18 +693,17 @@ namespace MemoryManager {
 		{
 			if constexpr (Local && !Write) {
 				std::memcpy(reinterpret_cast<void*>(address), content, length);
-				return;
-			}
-
-			ensure_open();
+			} else {
+				ensure_open();
 
 #ifdef __GLIBC__
-			const auto res = pwrite64(mem_interface, content, length, static_cast<off64_t>(address));
+				const auto res = pwrite64(mem_interface, content, length, static_cast<off64_t>(address));
 #else
-			const auto res = pwrite(mem_interface, content, length, static_cast<off_t>(address));
+				const auto res = pwrite(mem_interface, content, length, static_cast<off_t>(address));
 #endif
-			if (res == -1)
-				throw std::runtime_error(strerror(errno));
+				if (res == -1)
+					throw std::runtime_error(strerror(errno));
+			}
 		}
 
 		static_assert(AddressAware<RegionT>);
@@ -436,6 +712,7 @@ namespace MemoryManager {
 		static_assert(SharedAware<RegionT>);
 		static_assert(NameAware<RegionT>);
 		static_assert(PathAware<RegionT>);
+		static_assert(OffsetAware<RegionT>);
 		static_assert(!CAN_READ || Viewable<RegionT>);
 	};
 
@@ -0,0 +1,674 @@
+#ifndef MEMORYMANAGER_SNAPSHOTMEMORYMANAGER_HPP
+#define MEMORYMANAGER_SNAPSHOTMEMORYMANAGER_HPP
+
+#include "MemoryManager/MemoryManager.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+/**
+ * Snapshot file layout (all integers are stored in native byte order):
+ *
+ * SnapshotFileHeader
+ * padding up to page_size
+ * For every captured region, the contents of every present page, in order
+ * Index, for every region:
+ *   SnapshotRegionHeader
+ *   name (name_length bytes), path (path_length bytes)
+ *   page bitmap (bitmap_length bytes, one bit per page, a cleared bit means the page was all zeros and is omitted)
+ * SnapshotFileTrailer
+ *
+ * Since all data starts on a page boundary, the file can be mapped back without copying.
+ * The index is only written once all data is known, so the file is written strictly sequentially
+ * and can be streamed into a pipe or a socket.
+ */
+namespace MemoryManager {
+	struct SnapshotFileHeader {
+		static constexpr std::array<char, 8> MAGIC{ 'M', 'M', 'S', 'N', 'A', 'P', '\0', '\0' };
+		static constexpr std::uint32_t CURRENT_VERSION = 2;
+
+		std::array<char, 8> magic = MAGIC;
+		std::uint32_t version = CURRENT_VERSION;
+		std::uint32_t page_size;
+	};
+
+	struct SnapshotRegionHeader {
+		static constexpr std::uint8_t READABLE = 1 << 0;
+		static constexpr std::uint8_t WRITABLE = 1 << 1;
+		static constexpr std::uint8_t EXECUTABLE = 1 << 2;
+		static constexpr std::uint8_t SHARED = 1 << 3;
+		// Regions that couldn't be read have no bitmap and no data
+		static constexpr std::uint8_t CAPTURED = 1 << 4;
+
+		std::uint64_t address;
+		std::uint64_t length;
+		std::uint8_t attributes;
+		std::array<std::uint8_t, 3> reserved{};
+		std::uint32_t name_length;
+		std::uint32_t path_length;
+		std::uint32_t bitmap_length;
+		// Absolute offset of the first present page in the file
+		std::uint64_t data_offset;
+	};
+
+	struct SnapshotFileTrailer {
+		static constexpr std::array<char, 8> MAGIC{ 'M', 'M', 'I', 'N', 'D', 'E', 'X', '\0' };
+
+		std::uint64_t region_count;
+		// Absolute offset of the first region header
+		std::uint64_t index_offset;
+		std::array<char, 8> magic = MAGIC;
+	};
+
+	namespace Snapshot {
+		[[nodiscard]] inline bool is_zero(std::span<const std::byte> bytes) noexcept
+		{
+			std::uint64_t accumulator = 0;
+			std::size_t i = 0;
+			for (; i + sizeof(std::uint64_t) <= bytes.size(); i += sizeof(std::uint64_t)) {
+				std::uint64_t word = 0;
+				std::memcpy(&word, bytes.data() + i, sizeof(std::uint64_t));
+				accumulator |= word;
+			}
+			for (; i < bytes.size(); i++)
+				accumulator |= static_cast<std::uint8_t>(bytes[i]);
+			return accumulator == 0;
+		}
+
+		[[nodiscard]] constexpr std::size_t align_up(std::size_t value, std::size_t alignment) noexcept
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		// Keeps track of the position itself, since streams like pipes can't tell
+		class SequentialWriter {
+			std::ostream* stream;
+			std::uint64_t position = 0;
+
+		public:
+			explicit SequentialWriter(std::ostream& stream) noexcept
+				: stream(&stream)
+			{
+			}
+
+			[[nodiscard]] std::uint64_t get_position() const noexcept
+			{
+				return position;
+			}
+
+			void write(const void* data, std::size_t size)
+			{
+				stream->write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+				if (!*stream)
+					throw std::runtime_error{ "Failed to write snapshot" };
+				position += size;
+			}
+
+			template <typename T>
+			void write_object(const T& object)
+			{
+				write(&object, sizeof(T));
+			}
+
+			void pad_to(std::size_t alignment)
+			{
+				static constexpr std::array<char, 64> ZEROS{};
+				auto remaining = align_up(position, alignment) - position;
+				while (remaining > 0) {
+					const auto chunk = std::min(remaining, ZEROS.size());
+					write(ZEROS.data(), chunk);
+					remaining -= chunk;
+				}
+			}
+		};
+
+		template <typename T>
+		void append_object(std::vector<std::byte>& buffer, const T& object)
+		{
+			const auto* bytes = reinterpret_cast<const std::byte*>(&object);
+			buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+		}
+
+		inline void append_string(std::vector<std::byte>& buffer, const std::string& string)
+		{
+			const auto* bytes = reinterpret_cast<const std::byte*>(string.data());
+			buffer.insert(buffer.end(), bytes, bytes + string.size());
+		}
+	}
+
+	/**
+	 * Captures the layout of a memory manager and the contents of all readable regions into a stream.
+	 * Regions are read in chunks and the stream is never seeked, so the memory usage doesn't depend on the size of
+	 * the regions and the stream may be a pipe or a socket.
+	 * If a region fails to be read, only its header is kept, data that was already written for it stays unreferenced.
+	 * @param omit_zero_pages if set, pages that only contain zeros are not stored
+	 */
+	template <typename MemMgr>
+		requires LayoutAware<MemMgr> && AddressAware<typename MemMgr::RegionT> && LengthAware<typename MemMgr::RegionT>
+		&& (Reader<MemMgr> || Viewable<typename MemMgr::RegionT>)
+	void write_snapshot(const MemMgr& manager, std::ostream& stream, bool omit_zero_pages = true)
+	{
+		using RegionT = typename MemMgr::RegionT;
+
+		const std::size_t host_page_size = getpagesize();
+		std::size_t page_size = host_page_size;
+		if constexpr (GranularityAware<MemMgr>)
+			page_size = std::max(page_size, manager.get_page_granularity());
+
+		// Mapping the file back requires all data offsets to be aligned to the page size of the host
+		if (page_size % host_page_size != 0)
+			throw std::invalid_argument{ "Page granularity is not a multiple of the host page size" };
+
+		Snapshot::SequentialWriter writer{ stream };
+		writer.write_object(SnapshotFileHeader{ .page_size = static_cast<std::uint32_t>(page_size) });
+		writer.pad_to(page_size);
+
+		const auto& layout = manager.get_layout();
+		std::vector<std::byte> index;
+
+		constexpr std::size_t PAGES_PER_CHUNK = 256;
+		std::vector<std::byte> buffer(PAGES_PER_CHUNK * page_size);
+
+		for (const RegionT& region : layout) {
+			const std::size_t length = region.get_length();
+			const std::size_t page_count = Snapshot::align_up(length, page_size) / page_size;
+
+			bool captured = true;
+			if constexpr (FlagAware<RegionT>)
+				captured = region.get_flags().is_readable();
+
+			std::string name;
+			std::string path_string;
+			if constexpr (NameAware<RegionT>)
+				name = region.get_name().value_or("");
+			if constexpr (PathAware<RegionT>)
+				path_string = region.get_path().value_or("");
+
+			SnapshotRegionHeader header{
+				.address = region.get_address(),
+				.length = length,
+				.attributes = 0,
+				.name_length = static_cast<std::uint32_t>(name.size()),
+				.path_length = static_cast<std::uint32_t>(path_string.size()),
+				.bitmap_length = 0,
+				.data_offset = writer.get_position(),
+			};
+			if constexpr (FlagAware<RegionT>) {
+				const Flags flags = region.get_flags();
+				header.attributes |= flags.is_readable() ? SnapshotRegionHeader::READABLE : 0;
+				header.attributes |= flags.is_writeable() ? SnapshotRegionHeader::WRITABLE : 0;
+				header.attributes |= flags.is_executable() ? SnapshotRegionHeader::EXECUTABLE : 0;
+			}
+			if constexpr (SharedAware<RegionT>)
+				header.attributes |= region.is_shared() ? SnapshotRegionHeader::SHARED : 0;
+
+			std::vector<std::uint8_t> bitmap(captured ? (page_count + 7) / 8 : 0);
+			for (std::size_t page = 0; captured && page < page_count; page += PAGES_PER_CHUNK) {
+				const std::size_t chunk_pages = std::min(PAGES_PER_CHUNK, page_count - page);
+				const std::size_t chunk_offset = page * page_size;
+				const std::size_t chunk_length = std::min(chunk_pages * page_size, length - chunk_offset);
+
+				// Partial trailing pages are stored as full pages
+				std::ranges::fill(buffer, std::byte{});
+				try {
+					if constexpr (Reader<MemMgr>)
+						manager.read(region.get_address() + chunk_offset, buffer.data(), chunk_length);
+					else
+						std::ranges::copy(region.view().subspan(chunk_offset, chunk_length), buffer.begin());
+				} catch (const std::exception&) {
+					captured = false;
+					break;
+				}
+
+				for (std::size_t i = 0; i < chunk_pages; i++) {
+					const std::span page_bytes{ buffer.data() + i * page_size, page_size };
+					if (omit_zero_pages && Snapshot::is_zero(page_bytes))
+						continue;
+					bitmap[(page + i) / 8] |= 1 << ((page + i) % 8);
+					writer.write(page_bytes.data(), page_size);
+				}
+			}
+
+			if (captured) {
+				header.attributes |= SnapshotRegionHeader::CAPTURED;
+				header.bitmap_length = static_cast<std::uint32_t>(bitmap.size());
+			} else {
+				bitmap.clear();
+				header.data_offset = 0;
+			}
+
+			Snapshot::append_object(index, header);
+			Snapshot::append_string(index, name);
+			Snapshot::append_string(index, path_string);
+			index.insert(index.end(), reinterpret_cast<const std::byte*>(bitmap.data()), reinterpret_cast<const std::byte*>(bitmap.data() + bitmap.size()));
+		}
+
+		const SnapshotFileTrailer trailer{
+			.region_count = layout.size(),
+			.index_offset = writer.get_position(),
+		};
+		writer.write(index.data(), index.size());
+		writer.write_object(trailer);
+		stream.flush();
+	}
+
+	template <typename MemMgr>
+		requires LayoutAware<MemMgr> && AddressAware<typename MemMgr::RegionT> && LengthAware<typename MemMgr::RegionT>
+		&& (Reader<MemMgr> || Viewable<typename MemMgr::RegionT>)
+	void write_snapshot(const MemMgr& manager, const std::filesystem::path& path, bool omit_zero_pages = true)
+	{
+		std::ofstream stream{ path, std::ios::binary | std::ios::trunc };
+		if (!stream)
+			throw std::runtime_error{ "Failed to open " + path.string() };
+		write_snapshot(manager, stream, omit_zero_pages);
+	}
+
+	class SnapshotMemoryManager;
+
+	class SnapshotRegion {
+		struct Mapping {
+			void* address = nullptr;
+			std::size_t length = 0;
+
+			Mapping() = default;
+			Mapping(void* address, std::size_t length) noexcept
+				: address(address)
+				, length(length)
+			{
+			}
+			Mapping(Mapping&& other) noexcept
+				: address(std::exchange(other.address, nullptr))
+				, length(std::exchange(other.length, 0))
+			{
+			}
+			Mapping& operator=(Mapping&& other) noexcept
+			{
+				std::swap(address, other.address);
+				std::swap(length, other.length);
+				return *this;
+			}
+			Mapping(const Mapping&) = delete;
+			Mapping& operator=(const Mapping&) = delete;
+			~Mapping()
+			{
+				if (address != nullptr)
+					munmap(address, length);
+			}
+		};
+
+		std::uintptr_t address;
+		std::size_t length;
+		Flags flags;
+		bool shared;
+		bool captured;
+		std::optional<std::string> name;
+		std::optional<std::string> path;
+		std::span<const std::byte> data;
+		Mapping mapping; // only present if the region had to be reassembled from its present pages
+
+		friend SnapshotMemoryManager;
+
+	public:
+		SnapshotRegion(
+			std::uintptr_t address,
+			std::size_t length,
+			Flags flags,
+			bool shared,
+			bool captured,
+			std::optional<std::string> name,
+			std::optional<std::string> path) noexcept
+			: address(address)
+			, length(length)
+			, flags(flags)
+			, shared(shared)
+			, captured(captured)
+			, name(std::move(name))
+			, path(std::move(path))
+		{
+		}
+
+		[[nodiscard]] std::uintptr_t get_address() const noexcept
+		{
+			return address;
+		}
+
+		[[nodiscard]] std::size_t get_length() const noexcept
+		{
+			return length;
+		}
+
+		[[nodiscard]] Flags get_flags() const noexcept
+		{
+			return flags;
+		}
+
+		[[nodiscard]] bool is_shared() const noexcept
+		{
+			return shared;
+		}
+
+		[[nodiscard]] std::optional<std::string> get_name() const
+		{
+			return name;
+		}
+
+		[[nodiscard]] std::optional<std::string> get_path() const
+		{
+			return path;
+		}
+
+		// Indicates if the contents of this region are part of the snapshot, if not then the view is empty
+		[[nodiscard]] bool is_captured() const noexcept
+		{
+			return captured;
+		}
+
+		// The snapshot never changes, so the view can't go stale and can be used in place of read
+		[[nodiscard]] bool does_update_view() const noexcept
+		{
+			return true;
+		}
+
+		// The snapshot is immutable, so refreshing the view has no effect
+		[[nodiscard]] std::span<const std::byte> view(bool /*update_cache*/ = false) const noexcept
+		{
+			return data;
+		}
+	};
+
+	/**
+	 * Memory manager that serves a snapshot written by write_snapshot.
+	 * The file is mapped into memory, views point directly into the mapping.
+	 * Pages that were omitted from the file are backed by anonymous (zero) memory.
+	 * Regions with many runs of omitted pages are copied once the process would run low on mappings.
+	 */
+	class SnapshotMemoryManager {
+	public:
+		static constexpr bool REQUIRES_PERMISSIONS_FOR_READING = false;
+		static constexpr bool IS_LOCAL = false;
+
+		using RegionT = SnapshotRegion;
+
+	private:
+		// Stays well below the default vm.max_map_count of 65530
+		static constexpr std::size_t MAX_OVERLAY_MAPPINGS = 16384;
+
+		std::filesystem::path path;
+		std::size_t page_size = 0;
+		void* file_mapping = nullptr;
+		std::size_t file_size = 0;
+
+		MemoryLayout<RegionT> layout;
+
+		void unmap() noexcept
+		{
+			layout.clear();
+			if (file_mapping != nullptr) {
+				munmap(file_mapping, file_size);
+				file_mapping = nullptr;
+				file_size = 0;
+			}
+		}
+
+		[[nodiscard]] const std::byte* file_data() const noexcept
+		{
+			return static_cast<const std::byte*>(file_mapping);
+		}
+
+		void load(int file_descriptor)
+		{
+			struct stat file_stat{};
+			if (fstat(file_descriptor, &file_stat) == -1)
+				throw std::runtime_error(strerror(errno));
+			file_size = file_stat.st_size;
+
+			if (file_size < sizeof(SnapshotFileHeader))
+				throw std::runtime_error{ "Snapshot is truncated" };
+
+			file_mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+			if (file_mapping == MAP_FAILED) {
+				file_mapping = nullptr;
+				throw std::runtime_error(strerror(errno));
+			}
+
+			auto bytes_at = [this](std::size_t position, std::size_t size) {
+				if (position > file_size || size > file_size - position)
+					throw std::runtime_error{ "Snapshot is truncated" };
+				return file_data() + position;
+			};
+
+			SnapshotFileHeader file_header{};
+			std::memcpy(&file_header, bytes_at(0, sizeof(file_header)), sizeof(file_header));
+			if (file_header.magic != SnapshotFileHeader::MAGIC)
+				throw std::runtime_error{ "Not a snapshot" };
+			if (file_header.version != SnapshotFileHeader::CURRENT_VERSION)
+				throw std::runtime_error{ "Unsupported snapshot version " + std::to_string(file_header.version) };
+
+			page_size = file_header.page_size;
+			const std::size_t host_page_size = getpagesize();
+			if (page_size == 0 || page_size % host_page_size != 0)
+				throw std::runtime_error{ "Snapshot page size is not a multiple of the host page size" };
+
+			SnapshotFileTrailer trailer{};
+			if (file_size < sizeof(trailer))
+				throw std::runtime_error{ "Snapshot is truncated" };
+			std::memcpy(&trailer, bytes_at(file_size - sizeof(trailer), sizeof(trailer)), sizeof(trailer));
+			if (trailer.magic != SnapshotFileTrailer::MAGIC)
+				throw std::runtime_error{ "Snapshot is truncated" };
+
+			std::size_t position = trailer.index_offset;
+			auto consume = [&bytes_at, &position](std::size_t size) {
+				const std::byte* data = bytes_at(position, size);
+				position += size;
+				return data;
+			};
+
+			std::size_t mapping_budget = MAX_OVERLAY_MAPPINGS;
+			for (std::uint64_t i = 0; i < trailer.region_count; i++) {
+				SnapshotRegionHeader header{};
+				std::memcpy(&header, consume(sizeof(header)), sizeof(header));
+
+				auto read_string = [&consume](std::uint32_t length) -> std::optional<std::string> {
+					if (length == 0)
+						return std::nullopt;
+					const auto* data = reinterpret_cast<const char*>(consume(length));
+					return std::string{ data, length };
+				};
+				auto name = read_string(header.name_length);
+				auto region_path = read_string(header.path_length);
+
+				// Uncaptured regions have no contents, so they are never readable, regardless of their original protection
+				const bool captured = (header.attributes & SnapshotRegionHeader::CAPTURED) != 0;
+				RegionT region{
+					header.address,
+					header.length,
+					Flags{
+						captured && (header.attributes & SnapshotRegionHeader::READABLE) != 0,
+						(header.attributes & SnapshotRegionHeader::WRITABLE) != 0,
+						(header.attributes & SnapshotRegionHeader::EXECUTABLE) != 0,
+					},
+					(header.attributes & SnapshotRegionHeader::SHARED) != 0,
+					captured,
+					std::move(name),
+					std::move(region_path),
+				};
+
+				if (captured) {
+					const auto* bitmap = reinterpret_cast<const std::uint8_t*>(consume(header.bitmap_length));
+					map_region(region, file_descriptor, std::span{ bitmap, header.bitmap_length }, header.data_offset, mapping_budget);
+				}
+
+				layout.emplace(std::move(region));
+			}
+		}
+
+		// Points the view of the region at its data, overlays consume mappings from the budget
+		void map_region(RegionT& region, int file_descriptor, std::span<const std::uint8_t> bitmap, std::size_t region_data_offset, std::size_t& mapping_budget)
+		{
+			const std::size_t page_count = Snapshot::align_up(region.get_length(), page_size) / page_size;
+			if (bitmap.size() * 8 < page_count)
+				throw std::runtime_error{ "Snapshot page bitmap is too small" };
+
+			auto is_present = [&bitmap](std::size_t page) { return (bitmap[page / 8] & (1 << (page % 8))) != 0; };
+
+			std::size_t present_pages = 0;
+			std::size_t runs = 0;
+			for (std::size_t page = 0; page < page_count; page++)
+				if (is_present(page)) {
+					present_pages++;
+					runs += page == 0 || !is_present(page - 1) ? 1 : 0;
+				}
+
+			if (region_data_offset > file_size || present_pages * page_size > file_size - region_data_offset)
+				throw std::runtime_error{ "Snapshot is truncated" };
+
+			if (present_pages == page_count) {
+				// Nothing was omitted, the view can point straight into the file
+				region.data = std::span{ file_data() + region_data_offset, region.get_length() };
+				return;
+			}
+
+			const std::size_t mapping_length = page_count * page_size;
+			// Every overlay splits the anonymous mapping, which adds up to two mappings per run
+			const std::size_t required_mappings = 2 * runs + 1;
+			const bool overlay = required_mappings <= mapping_budget;
+
+			// Reserve zero-filled memory, then fill in every run of present pages
+			void* base = mmap(nullptr, mapping_length, overlay ? PROT_READ : PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (base == MAP_FAILED)
+				throw std::runtime_error(strerror(errno));
+			region.mapping = { base, mapping_length };
+
+			std::size_t file_page = 0;
+			for (std::size_t page = 0; page < page_count;) {
+				if (!is_present(page)) {
+					page++;
+					continue;
+				}
+
+				std::size_t run = 1;
+				while (page + run < page_count && is_present(page + run))
+					run++;
+
+				void* target = static_cast<std::byte*>(base) + page * page_size;
+				const std::size_t offset = region_data_offset + file_page * page_size;
+				if (!overlay)
+					std::memcpy(target, file_data() + offset, run * page_size);
+				else if (mmap(target, run * page_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, file_descriptor, static_cast<off_t>(offset)) == MAP_FAILED)
+					throw std::runtime_error(strerror(errno));
+
+				page += run;
+				file_page += run;
+			}
+
+			if (overlay)
+				mapping_budget -= required_mappings;
+			else if (mprotect(base, mapping_length, PROT_READ) == -1)
+				throw std::runtime_error(strerror(errno));
+
+			region.data = std::span{ static_cast<const std::byte*>(base), region.get_length() };
+		}
+
+	public:
+		explicit SnapshotMemoryManager(std::filesystem::path path)
+			: path(std::move(path))
+		{
+			sync_layout();
+		}
+
+		~SnapshotMemoryManager()
+		{
+			unmap();
+		}
+
+		// Views point into a mapping owned by this manager
+		SnapshotMemoryManager(const SnapshotMemoryManager& other) = delete;
+		SnapshotMemoryManager& operator=(const SnapshotMemoryManager& other) = delete;
+
+		[[nodiscard]] const std::filesystem::path& get_snapshot_path() const noexcept
+		{
+			return path;
+		}
+
+		[[nodiscard]] const MemoryLayout<RegionT>& get_layout() const noexcept
+		{
+			return layout;
+		}
+
+		// Remaps the snapshot file, which picks up the snapshot if it has been rewritten
+		void sync_layout()
+		{
+			unmap();
+
+			const int file_descriptor = ::open(path.c_str(), O_RDONLY);
+			if (file_descriptor == -1)
+				throw std::runtime_error(strerror(errno));
+
+			try {
+				load(file_descriptor);
+			} catch (...) {
+				::close(file_descriptor);
+				unmap();
+				throw;
+			}
+
+			::close(file_descriptor);
+		}
+
+		[[nodiscard]] std::size_t get_page_granularity() const noexcept
+		{
+			return page_size;
+		}
+
+		void read(std::uintptr_t address, void* content, std::size_t length) const
+		{
+			auto* destination = static_cast<std::byte*>(content);
+			while (length > 0) {
+				const RegionT* region = layout.find_region(address);
+				if (region == nullptr || !region->is_captured())
+					throw std::runtime_error{ "Address is not part of the snapshot" };
+
+				const std::size_t offset = address - region->get_address();
+				const std::size_t chunk = std::min(length, region->get_length() - offset);
+				std::memcpy(destination, region->view().data() + offset, chunk);
+
+				destination += chunk;
+				address += chunk;
+				length -= chunk;
+			}
+		}
+	};
+
+	static_assert(AddressAware<SnapshotRegion>);
+	static_assert(LengthAware<SnapshotRegion>);
+	static_assert(FlagAware<SnapshotRegion>);
+	static_assert(SharedAware<SnapshotRegion>);
+	static_assert(NameAware<SnapshotRegion>);
+	static_assert(PathAware<SnapshotRegion>);
+	static_assert(Viewable<SnapshotRegion>);
+
+	static_assert(LayoutAware<SnapshotMemoryManager>);
+	static_assert(GranularityAware<SnapshotMemoryManager>);
+	static_assert(Reader<SnapshotMemoryManager>);
+	static_assert(LocalAware<SnapshotMemoryManager> && !SnapshotMemoryManager::IS_LOCAL);
+}
+
+#endif